@@ -0,0 +1,112 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#ifndef KD45_CONTROLLER_ACTIVE_GOAL_H
+#define KD45_CONTROLLER_ACTIVE_GOAL_H
+
+#include <cstdint>
+#include <mutex>
+
+#include <mailbox.h>
+
+namespace kd45_controller {
+
+// the goal followed by the realtime loop. non-realtime threads install accepted goals, the realtime loop adopts the
+// latest one at the start of its cycle and owns it from then on: it may finish it or move on to a goal queued behind
+// it until the next goal is installed. installed goals are handed over through a mailbox, so they stay valid for the
+// realtime loop until it has adopted a newer one; goals activated by the realtime loop itself have to be kept alive
+// by the caller the same way.
+template <class GoalPtr>
+class ActiveGoal
+{
+public:
+	typedef typename GoalPtr::element_type Goal;
+
+	explicit ActiveGoal(EpochDomain& domain) : mailbox_(domain) {}
+
+	ActiveGoal(const ActiveGoal&) = delete;
+	ActiveGoal& operator=(const ActiveGoal&) = delete;
+
+	// non-realtime, replaces the goal followed by the realtime loop, null to follow none
+	void install(const GoalPtr& goal) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		installed_ = goal;
+		mailbox_.publish(Installation{ goal, ++installations_ });
+	}
+
+	// non-realtime, the goal installed last. the realtime loop may have finished it or moved on to a queued goal
+	GoalPtr installed() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return installed_;
+	}
+
+	// realtime, after EpochDomain::enter(): adopts a goal installed since the last call, true if there was one
+	bool update() {
+		const Installation& installation = mailbox_.read();
+		if (installation.number == adopted_) return false;
+		adopted_ = installation.number;
+		current_ = installation.goal.get();
+		return true;
+	}
+
+	// realtime, null without an active goal
+	Goal* get() const { return current_; }
+	// realtime, until the next installed goal is adopted
+	void set(Goal* goal) { current_ = goal; }
+
+private:
+	// the number makes every installation distinct, also when the same goal or null is installed again
+	struct Installation
+	{
+		GoalPtr goal;
+		uint64_t number;
+	};
+
+	mutable std::mutex mutex_;
+	GoalPtr installed_;
+	uint64_t installations_ = 0;
+	Mailbox<Installation> mailbox_;
+
+	// realtime side
+	uint64_t adopted_ = 0;
+	Goal* current_ = nullptr;
+};
+}
+
+#endif  // KD45_CONTROLLER_ACTIVE_GOAL_H
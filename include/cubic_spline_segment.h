@@ -0,0 +1,139 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_CUBIC_SPLINE_SEGMENT_H
+#define KD45_CONTROLLER_CUBIC_SPLINE_SEGMENT_H
+
+#include <trajectory_interface/pos_vel_acc_state.h>
+
+#include <array>
+#include <stdexcept>
+#include <vector>
+
+namespace kd45_controller {
+
+// cubic hermite spline between two position/velocity states, drop-in replacement for
+// trajectory_interface::QuinticSplineSegment. accelerations of the boundary states are ignored. if no velocities
+// are given, the segment degrades to linear interpolation.
+template <class ScalarType>
+class CubicSplineSegment
+{
+public:
+	typedef ScalarType Scalar;
+	typedef Scalar Time;
+	typedef trajectory_interface::PosVelAccState<Scalar> State;
+
+	CubicSplineSegment() : duration_(static_cast<Scalar>(0)), start_time_(static_cast<Scalar>(0)) {}
+
+	CubicSplineSegment(const Time& start_time, const State& start_state, const Time& end_time,
+	                   const State& end_state) {
+		init(start_time, start_state, end_time, end_state);
+	}
+
+	void init(const Time& start_time, const State& start_state, const Time& end_time, const State& end_state) {
+		if (end_time < start_time) {
+			throw(std::invalid_argument("Cubic spline segment can't be constructed: end_time < start_time."));
+		}
+		if (start_state.position.empty() || end_state.position.empty()) {
+			throw(std::invalid_argument("Cubic spline segment can't be constructed: Endpoint positions can't be empty."));
+		}
+		if (start_state.position.size() != end_state.position.size()) {
+			throw(std::invalid_argument("Cubic spline segment can't be constructed: Endpoint positions size mismatch."));
+		}
+
+		const unsigned int dim = start_state.position.size();
+		const bool has_velocity = !start_state.velocity.empty() && !end_state.velocity.empty();
+		if (has_velocity && (start_state.velocity.size() != dim || end_state.velocity.size() != dim)) {
+			throw(std::invalid_argument("Cubic spline segment can't be constructed: Endpoint velocities size mismatch."));
+		}
+
+		start_time_ = start_time;
+		duration_ = end_time - start_time;
+
+		coefs_.resize(dim);
+		for (unsigned int i = 0; i < dim; ++i) {
+			const Scalar p0 = start_state.position[i];
+			const Scalar p1 = end_state.position[i];
+			const Scalar v0 = has_velocity ? start_state.velocity[i] : 0.0;
+			const Scalar v1 = has_velocity ? end_state.velocity[i] : 0.0;
+			SplineCoefficients& coefs = coefs_[i];
+
+			if (duration_ <= 0.0) {
+				coefs = { { p1, 0.0, 0.0, 0.0 } };
+			} else if (!has_velocity) {
+				coefs = { { p0, (p1 - p0) / duration_, 0.0, 0.0 } };
+			} else {
+				const Scalar T = duration_;
+				const Scalar T2 = T * T;
+				coefs = { { p0, v0, (3.0 * (p1 - p0) - (2.0 * v0 + v1) * T) / T2,
+					         (2.0 * (p0 - p1) + (v0 + v1) * T) / (T2 * T) } };
+			}
+		}
+	}
+
+	void sample(const Time& time, State& state) const {
+		// Resize state data. Should be a no-op if appropriately sized
+		state.position.resize(size());
+		state.velocity.resize(size());
+		state.acceleration.resize(size());
+
+		// Outside of the segment the boundary position is held
+		const bool inside = time >= start_time_ && time <= start_time_ + duration_;
+		const Time t = time < start_time_ ? 0.0 : (inside ? time - start_time_ : duration_);
+		for (unsigned int i = 0; i < size(); ++i) {
+			const SplineCoefficients& c = coefs_[i];
+			state.position[i] = c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+			state.velocity[i] = inside ? c[1] + t * (2.0 * c[2] + t * 3.0 * c[3]) : 0.0;
+			state.acceleration[i] = inside ? 2.0 * c[2] + 6.0 * c[3] * t : 0.0;
+		}
+	}
+
+	Time startTime() const { return start_time_; }
+	Time endTime() const { return start_time_ + duration_; }
+	unsigned int size() const { return coefs_.size(); }
+
+private:
+	typedef std::array<Scalar, 4> SplineCoefficients;
+
+	std::vector<SplineCoefficients> coefs_;
+	Time duration_;
+	Time start_time_;
+};
+}
+
+#endif  // KD45_CONTROLLER_CUBIC_SPLINE_SEGMENT_H
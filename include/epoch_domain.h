@@ -0,0 +1,171 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_EPOCH_DOMAIN_H
+#define KD45_CONTROLLER_EPOCH_DOMAIN_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kd45_controller {
+
+// epoch-based reclamation for objects shared between non-realtime threads and the realtime loop.
+// writers unlink an object, then retire it. the realtime loop is the single reader: it announces the current epoch at
+// the start of every cycle and may use everything it reached until the next announcement. a retired object is freed
+// by the background reclaimer once the reader has announced a later epoch, so the reader never blocks, spins or
+// frees memory.
+class EpochDomain
+{
+public:
+	EpochDomain() = default;
+	~EpochDomain();
+
+	EpochDomain(const EpochDomain&) = delete;
+	EpochDomain& operator=(const EpochDomain&) = delete;
+
+	// starts the background reclaimer, without it retired objects are only freed by reclaim() and the destructor
+	void startReclaimer(std::chrono::milliseconds period);
+	void stopReclaimer();
+
+	// realtime reader, a single store: objects reached before are released
+	void enter() { reader_epoch_.store(epoch_.load(std::memory_order_acquire)); }
+	// realtime reader: nothing is held, e.g. while the controller is stopped
+	void quiesce() { reader_epoch_.store(kQuiescent); }
+
+	// non-realtime, after the object has been unlinked: free is called once the reader can not reach it anymore
+	void retire(std::function<void()> free);
+	// non-realtime, frees what is safe to free now
+	void reclaim();
+
+	size_t retiredCount();
+
+private:
+	struct Retired
+	{
+		uint64_t epoch;
+		std::function<void()> free;
+	};
+
+	// only used by value, so there is no out-of-line definition that would be defined in every translation unit
+	static constexpr uint64_t kQuiescent = std::numeric_limits<uint64_t>::max();
+
+	void runReclaimer(std::chrono::milliseconds period);
+
+	// the announcement and its check in reclaim() have to be sequentially consistent: with a relaxed store the writer
+	// could miss an announcement that read an unlinked object. it is still the only store of the reader per cycle.
+	std::atomic<uint64_t> epoch_{ 1 };
+	std::atomic<uint64_t> reader_epoch_{ kQuiescent };
+
+	std::mutex retired_mutex_;
+	std::vector<Retired> retired_;
+
+	std::mutex reclaimer_mutex_;
+	std::condition_variable reclaimer_cv_;
+	bool reclaimer_running_ = false;
+	std::thread reclaimer_;
+};
+
+inline EpochDomain::~EpochDomain() {
+	stopReclaimer();
+	for (Retired& retired : retired_) retired.free();
+}
+
+inline void EpochDomain::startReclaimer(std::chrono::milliseconds period) {
+	std::lock_guard<std::mutex> lock(reclaimer_mutex_);
+	if (reclaimer_running_) return;
+	reclaimer_running_ = true;
+	reclaimer_ = std::thread(&EpochDomain::runReclaimer, this, period);
+}
+
+inline void EpochDomain::stopReclaimer() {
+	{
+		std::lock_guard<std::mutex> lock(reclaimer_mutex_);
+		if (!reclaimer_running_) return;
+		reclaimer_running_ = false;
+	}
+	reclaimer_cv_.notify_all();
+	reclaimer_.join();
+}
+
+inline void EpochDomain::retire(std::function<void()> free) {
+	// readers announcing the new epoch or a later one entered after the object was unlinked
+	const uint64_t epoch = epoch_.fetch_add(1) + 1;
+	std::lock_guard<std::mutex> lock(retired_mutex_);
+	retired_.push_back(Retired{ epoch, std::move(free) });
+}
+
+inline void EpochDomain::reclaim() {
+	std::vector<Retired> reclaimable;
+	{
+		std::lock_guard<std::mutex> lock(retired_mutex_);
+		const uint64_t reader_epoch = reader_epoch_.load();
+		auto kept = std::partition(retired_.begin(), retired_.end(),
+		                           [reader_epoch](const Retired& retired) { return retired.epoch > reader_epoch; });
+		reclaimable.assign(std::make_move_iterator(kept), std::make_move_iterator(retired_.end()));
+		retired_.erase(kept, retired_.end());
+	}
+	// freeing may take a while, e.g. for trajectories, don't block writers meanwhile
+	for (Retired& retired : reclaimable) retired.free();
+}
+
+inline size_t EpochDomain::retiredCount() {
+	std::lock_guard<std::mutex> lock(retired_mutex_);
+	return retired_.size();
+}
+
+inline void EpochDomain::runReclaimer(std::chrono::milliseconds period) {
+	std::unique_lock<std::mutex> lock(reclaimer_mutex_);
+	while (reclaimer_running_) {
+		reclaimer_cv_.wait_for(lock, period, [this] { return !reclaimer_running_; });
+		lock.unlock();
+		reclaim();
+		lock.lock();
+	}
+}
+}
+
+#endif  // KD45_CONTROLLER_EPOCH_DOMAIN_H
@@ -0,0 +1,120 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_ERROR_STRING_H
+#define KD45_CONTROLLER_ERROR_STRING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <string>
+
+namespace kd45_controller {
+
+// fixed capacity, null terminated string for error descriptions composed in the realtime loop.
+// formatting truncates at the capacity and does not allocate.
+template <size_t Capacity>
+class FixedString
+{
+public:
+	FixedString() { clear(); }
+
+	void clear() {
+		size_ = 0;
+		data_[0] = '\0';
+	}
+
+	// printf-style, replaces the content
+	void format(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+		va_list args;
+		va_start(args, fmt);
+		clear();
+		vappend(fmt, args);
+		va_end(args);
+	}
+
+	// printf-style, appends to the content
+	void append(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+		va_list args;
+		va_start(args, fmt);
+		vappend(fmt, args);
+		va_end(args);
+	}
+
+	const char* c_str() const { return data_; }
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+private:
+	void vappend(const char* fmt, va_list args) {
+		if (size_ + 1 >= Capacity) return;
+		const int written = std::vsnprintf(data_ + size_, Capacity - size_, fmt, args);
+		if (written > 0) size_ = std::min(size_ + static_cast<size_t>(written), Capacity - 1);
+	}
+
+	char data_[Capacity];
+	size_t size_;
+};
+
+typedef FixedString<256> ErrorString;
+
+// describes which quantities of a joint state error exceed their tolerances, e.g.
+// "Path tolerance violated for joint gripper_left_finger_joint: position error 0.0132 > 0.01"
+template <size_t Capacity, class State, class Tolerances>
+inline void describeToleranceViolation(FixedString<Capacity>& error, const char* tolerance, const std::string& joint,
+                                       const State& state_error, const Tolerances& tolerances) {
+	error.format("%s tolerance violated for joint %s:", tolerance, joint.c_str());
+	const size_t prefix = error.size();
+	if (tolerances.position > 0.0 && std::abs(state_error.position[0]) > tolerances.position) {
+		error.append(" position error %g > %g", static_cast<double>(state_error.position[0]),
+		             static_cast<double>(tolerances.position));
+	}
+	if (tolerances.velocity > 0.0 && std::abs(state_error.velocity[0]) > tolerances.velocity) {
+		error.append(" velocity error %g > %g", static_cast<double>(state_error.velocity[0]),
+		             static_cast<double>(tolerances.velocity));
+	}
+	if (tolerances.acceleration > 0.0 && std::abs(state_error.acceleration[0]) > tolerances.acceleration) {
+		error.append(" acceleration error %g > %g", static_cast<double>(state_error.acceleration[0]),
+		             static_cast<double>(tolerances.acceleration));
+	}
+	if (error.size() == prefix) error.append(" unknown quantity");
+}
+}
+
+#endif  // KD45_CONTROLLER_ERROR_STRING_H
@@ -0,0 +1,242 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_FAULT_DETECTOR_H
+#define KD45_CONTROLLER_FAULT_DETECTOR_H
+
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+namespace kd45_controller {
+
+// detects mechanical faults of the gripper from the tracking errors, joint velocities and tactile forces.
+// every fault has to persist for a configured time before it is raised. update() keeps a few timers per finger and
+// runs in constant time, faults are logged and published as diagnostics from a non-realtime timer.
+template <class Scalar, unsigned int NumFingers>
+class FaultDetector
+{
+public:
+	enum Fault : uint32_t
+	{
+		NONE = 0,
+		// the finger does not follow its trajectory and does not touch anything either
+		BLOCKED = 1 << 0,
+		// contact force appears on a finger that has not been moving
+		FORCE_WITHOUT_MOTION = 1 << 1,
+		// in contact, but the finger forces differ persistently
+		ASYMMETRY = 1 << 2,
+	};
+
+	// reads the "fault_detection" namespace
+	void init(ros::NodeHandle& nh);
+	bool enabled() const { return enabled_; }
+	// abort the active goal when a fault is raised
+	bool abortGoal() const { return abort_goal_; }
+
+	void reset();
+
+	// realtime, returns the faults raised in this cycle
+	uint32_t update(const Scalar* position_error, const Scalar* velocity, const float* force, double contact_threshold,
+	                double dt);
+
+	// faults present in the last cycle
+	uint32_t active() const { return active_.load(std::memory_order_relaxed); }
+	uint64_t raised(Fault fault) const { return raised_[index(fault)].load(std::memory_order_relaxed); }
+
+	static const char* describe(Fault fault);
+	// the first fault set in faults
+	static Fault first(uint32_t faults) { return static_cast<Fault>(faults & (~faults + 1)); }
+
+private:
+	static constexpr unsigned int kNumFaults = 3;
+	static unsigned int index(Fault fault) { return fault == BLOCKED ? 0 : fault == FORCE_WITHOUT_MOTION ? 1 : 2; }
+
+	void report(const ros::TimerEvent& event);
+
+	bool enabled_ = false;
+	bool abort_goal_ = false;
+	double blocked_error_ = 0.01;
+	double still_velocity_ = 0.005;
+	double blocked_time_ = 0.5;
+	double still_time_ = 0.5;
+	double asymmetry_ratio_ = 0.5;
+	double asymmetry_time_ = 1.0;
+
+	// realtime state
+	std::array<double, NumFingers> blocked_for_;
+	std::array<double, NumFingers> still_for_;
+	std::array<bool, NumFingers> in_contact_;
+	double asymmetric_for_ = 0.0;
+	uint32_t previous_ = NONE;
+
+	// read from the non-realtime side
+	std::atomic<uint32_t> active_{ NONE };
+	std::array<std::atomic<uint64_t>, kNumFaults> raised_;
+
+	ros::Timer report_timer_;
+	uint32_t reported_ = NONE;
+	ros::Publisher diagnostics_pub_;
+	diagnostic_msgs::DiagnosticArray diagnostics_;
+};
+
+template <class Scalar, unsigned int NumFingers>
+inline void FaultDetector<Scalar, NumFingers>::init(ros::NodeHandle& nh) {
+	ros::NodeHandle fault_nh(nh, "fault_detection");
+	fault_nh.param("enabled", enabled_, false);
+	fault_nh.param("abort_goal", abort_goal_, false);
+	fault_nh.param("blocked_error", blocked_error_, 0.01);
+	fault_nh.param("still_velocity", still_velocity_, 0.005);
+	fault_nh.param("blocked_time", blocked_time_, 0.5);
+	fault_nh.param("still_time", still_time_, 0.5);
+	fault_nh.param("asymmetry_ratio", asymmetry_ratio_, 0.5);
+	fault_nh.param("asymmetry_time", asymmetry_time_, 1.0);
+
+	for (auto& raised : raised_) raised.store(0, std::memory_order_relaxed);
+	reset();
+	if (!enabled_) return;
+
+	// one status with the active faults and how often each fault was raised
+	diagnostics_.status.resize(1);
+	diagnostic_msgs::DiagnosticStatus& status = diagnostics_.status[0];
+	status.name = fault_nh.getNamespace();
+	status.hardware_id = "kd45";
+	status.values.resize(kNumFaults);
+	for (uint32_t fault = BLOCKED; fault <= ASYMMETRY; fault <<= 1)
+		status.values[index(static_cast<Fault>(fault))].key = describe(static_cast<Fault>(fault));
+	diagnostics_pub_ = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+
+	report_timer_ = nh.createTimer(ros::Duration(0.1), &FaultDetector::report, this);
+	ROS_INFO_STREAM_NAMED("KD45C", "Fault detection enabled, aborting goals on faults: " << (abort_goal_ ? "yes" : "no"));
+}
+
+template <class Scalar, unsigned int NumFingers>
+inline void FaultDetector<Scalar, NumFingers>::reset() {
+	blocked_for_.fill(0.0);
+	still_for_.fill(0.0);
+	in_contact_.fill(false);
+	asymmetric_for_ = 0.0;
+	previous_ = NONE;
+	active_.store(NONE, std::memory_order_relaxed);
+}
+
+template <class Scalar, unsigned int NumFingers>
+inline uint32_t FaultDetector<Scalar, NumFingers>::update(const Scalar* position_error, const Scalar* velocity,
+                                                          const float* force, double contact_threshold, double dt) {
+	uint32_t faults = NONE;
+	float max_force = 0.0f, min_force = force[0];
+	for (unsigned int i = 0; i < NumFingers; ++i) {
+		const bool moving = std::abs(velocity[i]) > still_velocity_;
+		const bool contact = force[i] > contact_threshold;
+
+		const bool blocked = !contact && !moving && std::abs(position_error[i]) > blocked_error_;
+		blocked_for_[i] = blocked ? blocked_for_[i] + dt : 0.0;
+		if (blocked_for_[i] >= blocked_time_) faults |= BLOCKED;
+
+		// held until the contact ends
+		if (contact && (!in_contact_[i] ? still_for_[i] >= still_time_ : (previous_ & FORCE_WITHOUT_MOTION) != 0)) {
+			faults |= FORCE_WITHOUT_MOTION;
+		}
+		still_for_[i] = moving ? 0.0 : still_for_[i] + dt;
+		in_contact_[i] = contact;
+
+		max_force = std::max(max_force, force[i]);
+		min_force = std::min(min_force, force[i]);
+	}
+
+	const bool asymmetric = max_force > contact_threshold && max_force - min_force > asymmetry_ratio_ * max_force;
+	asymmetric_for_ = asymmetric ? asymmetric_for_ + dt : 0.0;
+	if (asymmetric_for_ >= asymmetry_time_) faults |= ASYMMETRY;
+
+	const uint32_t raised = faults & ~previous_;
+	for (unsigned int i = 0; i < kNumFaults; ++i) {
+		if (raised & (1u << i)) raised_[i].fetch_add(1, std::memory_order_relaxed);
+	}
+	previous_ = faults;
+	active_.store(faults, std::memory_order_relaxed);
+	return raised;
+}
+
+template <class Scalar, unsigned int NumFingers>
+inline const char* FaultDetector<Scalar, NumFingers>::describe(Fault fault) {
+	switch (fault) {
+		case BLOCKED:
+			return "Finger blocked without tactile contact";
+		case FORCE_WITHOUT_MOTION:
+			return "Contact force on a finger that was not moving";
+		case ASYMMETRY:
+			return "Persistent asymmetry of the finger forces";
+		default:
+			return "No fault";
+	}
+}
+
+template <class Scalar, unsigned int NumFingers>
+inline void FaultDetector<Scalar, NumFingers>::report(const ros::TimerEvent& /*event*/) {
+	const uint32_t faults = active();
+	for (uint32_t fault = BLOCKED; fault <= ASYMMETRY; fault <<= 1) {
+		if ((faults & fault) && !(reported_ & fault)) {
+			ROS_WARN_STREAM_NAMED("KD45C", "Gripper fault: " << describe(static_cast<Fault>(fault)));
+		} else if (!(faults & fault) && (reported_ & fault)) {
+			ROS_INFO_STREAM_NAMED("KD45C", "Gripper fault cleared: " << describe(static_cast<Fault>(fault)));
+		}
+	}
+	reported_ = faults;
+
+	diagnostic_msgs::DiagnosticStatus& status = diagnostics_.status[0];
+	status.level = faults ? diagnostic_msgs::DiagnosticStatus::ERROR : diagnostic_msgs::DiagnosticStatus::OK;
+	status.message = faults ? "" : describe(NONE);
+	for (uint32_t fault = BLOCKED; fault <= ASYMMETRY; fault <<= 1) {
+		const Fault f = static_cast<Fault>(fault);
+		status.values[index(f)].value = std::to_string(raised(f)) + (faults & fault ? " raised, active" : " raised");
+		if (!(faults & fault)) continue;
+		if (!status.message.empty()) status.message += "; ";
+		status.message += describe(f);
+	}
+	diagnostics_.header.stamp = ros::Time::now();
+	diagnostics_pub_.publish(diagnostics_);
+}
+}
+
+#endif  // KD45_CONTROLLER_FAULT_DETECTOR_H
@@ -0,0 +1,163 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#ifndef KD45_CONTROLLER_FORCE_CHANNEL_H
+#define KD45_CONTROLLER_FORCE_CHANNEL_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <seqlock.h>
+
+namespace kd45_controller {
+
+// tactile forces from the sensor to the control loop. besides the latest sample, the sensor side keeps a summary of
+// all samples since the control loop took the last one (minimum, maximum and mean per finger), updated incrementally
+// with every sample. Sensors faster than the control loop so don't hide short events between two cycles.
+//
+// the summary is published through a sequence lock. The consumer acknowledges the summary it took, the next sample
+// starts a new one only if the consumer has seen all samples of the current one. Samples published while the consumer
+// was taking the summary are therefore reported again with the next summary rather than lost.
+template <unsigned int NumFingers>
+class ForceChannel
+{
+public:
+	typedef std::array<float, NumFingers> Forces;
+
+	struct Summary
+	{
+		Forces min;
+		Forces max;
+		Forces mean;
+		Forces last;
+		uint32_t count;
+		uint32_t epoch;
+	};
+
+	ForceChannel() : summary_(Summary{}) {}
+
+	// sensor thread, a single sample that becomes the latest one
+	void store(const Forces& forces) {
+		accumulate(forces);
+		publish(forces);
+	}
+	// sensor thread, adds a sample to the summary without publishing it, e.g. for a batch of samples
+	void accumulate(const Forces& forces);
+	// sensor thread, publishes the summary with the latest of the accumulated samples
+	void publish(const Forces& latest);
+
+	// any thread, the latest sample. false if the sensor was writing, forces are left unchanged then
+	bool tryLoad(Forces& forces, unsigned int attempts = 4) const;
+
+	// realtime, single consumer. The summary of the samples since the last take, returns the number of new samples.
+	// Without new samples, the summary collapses to the latest sample. If the sensor was writing, summary is left
+	// unchanged and 0 is returned
+	unsigned int take(Summary& summary);
+
+private:
+	static uint64_t position(uint32_t epoch, uint32_t count) { return static_cast<uint64_t>(epoch) << 32 | count; }
+
+	SeqLock<Summary> summary_;
+	// epoch and count of the summary the consumer took last
+	std::atomic<uint64_t> taken_{ 0 };
+
+	// sensor thread
+	Summary accumulated_{};
+	std::array<double, NumFingers> sum_{};
+	uint32_t published_count_ = 0;
+
+	// consumer
+	uint64_t consumed_ = 0;
+};
+
+template <unsigned int NumFingers>
+inline void ForceChannel<NumFingers>::accumulate(const Forces& forces) {
+	// A new summary once the consumer saw everything published so far
+	const bool seen = taken_.load(std::memory_order_acquire) == position(accumulated_.epoch, published_count_) &&
+	                  accumulated_.count == published_count_;
+	if (seen) {
+		accumulated_.epoch++;
+		accumulated_.count = 0;
+		published_count_ = 0;
+	}
+
+	for (unsigned int i = 0; i < NumFingers; ++i) {
+		accumulated_.min[i] = accumulated_.count ? std::min(accumulated_.min[i], forces[i]) : forces[i];
+		accumulated_.max[i] = accumulated_.count ? std::max(accumulated_.max[i], forces[i]) : forces[i];
+		sum_[i] = accumulated_.count ? sum_[i] + forces[i] : forces[i];
+	}
+	accumulated_.count++;
+}
+
+template <unsigned int NumFingers>
+inline void ForceChannel<NumFingers>::publish(const Forces& latest) {
+	for (unsigned int i = 0; i < NumFingers; ++i) accumulated_.mean[i] = static_cast<float>(sum_[i] / accumulated_.count);
+	accumulated_.last = latest;
+	published_count_ = accumulated_.count;
+	summary_.store(accumulated_);
+}
+
+template <unsigned int NumFingers>
+inline bool ForceChannel<NumFingers>::tryLoad(Forces& forces, unsigned int attempts) const {
+	Summary summary;
+	if (!summary_.tryLoad(summary, attempts)) return false;
+	forces = summary.last;
+	return true;
+}
+
+template <unsigned int NumFingers>
+inline unsigned int ForceChannel<NumFingers>::take(Summary& summary) {
+	Summary taken;
+	if (!summary_.tryLoad(taken)) return 0;
+
+	const uint64_t taken_position = position(taken.epoch, taken.count);
+	const uint32_t consumed = taken.epoch == static_cast<uint32_t>(consumed_ >> 32) ? static_cast<uint32_t>(consumed_) : 0;
+	const unsigned int samples = taken.count - consumed;
+	taken_.store(taken_position, std::memory_order_release);
+	consumed_ = taken_position;
+
+	summary = taken;
+	if (samples == 0) summary.min = summary.max = summary.mean = summary.last;
+	return samples;
+}
+}
+
+#endif  // KD45_CONTROLLER_FORCE_CHANNEL_H
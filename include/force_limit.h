@@ -0,0 +1,143 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#ifndef KD45_CONTROLLER_FORCE_LIMIT_H
+#define KD45_CONTROLLER_FORCE_LIMIT_H
+
+#include <ros/ros.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+
+#include <seqlock.h>
+
+namespace kd45_controller {
+
+// maximum force on the tactile pads, checked by the sensor for every sample it receives instead of once per control
+// cycle. A sample above the limit trips the limit once, it is armed again when all forces are back below the limit.
+// The controller picks up trips lock-free, they are logged from a non-realtime timer.
+template <unsigned int NumFingers>
+class ForceLimit
+{
+public:
+	// the sample that tripped the limit
+	struct Event
+	{
+		std::array<float, NumFingers> force;
+		uint32_t finger;
+		double stamp;
+	};
+
+	// reads the "force_limit" namespace
+	void init(ros::NodeHandle& nh);
+	bool enabled() const { return max_force_ > 0.0; }
+	double maxForce() const { return max_force_; }
+
+	// sensor thread, for every sample
+	void check(const std::array<float, NumFingers>& force, const ros::Time& stamp);
+	// true while the latest sample is above the limit
+	bool above() const { return above_.load(std::memory_order_acquire); }
+
+	// realtime, true once after every trip
+	bool consumeTrip() { return pending_.exchange(false, std::memory_order_acq_rel); }
+	// the latest trip, false if it is being written right now
+	bool lastEvent(Event& event) const { return event_.tryLoad(event); }
+	uint64_t trips() const { return trips_.load(std::memory_order_relaxed); }
+
+private:
+	void report(const ros::TimerEvent& event);
+
+	double max_force_ = 0.0;
+
+	// written by the sensor thread
+	std::atomic<bool> above_{ false };
+
+	std::atomic<bool> pending_{ false };
+	std::atomic<uint64_t> trips_{ 0 };
+	SeqLock<Event> event_;
+
+	ros::Timer report_timer_;
+	uint64_t reported_ = 0;
+};
+
+template <unsigned int NumFingers>
+inline void ForceLimit<NumFingers>::init(ros::NodeHandle& nh) {
+	nh.param("force_limit/max_force", max_force_, 0.0);
+	if (!enabled()) return;
+
+	report_timer_ = nh.createTimer(ros::Duration(0.1), &ForceLimit::report, this);
+	ROS_INFO_STREAM_NAMED("KD45C", "Limiting the tactile forces to " << max_force_);
+}
+
+template <unsigned int NumFingers>
+inline void ForceLimit<NumFingers>::check(const std::array<float, NumFingers>& force, const ros::Time& stamp) {
+	if (!enabled()) return;
+
+	unsigned int finger = NumFingers;
+	for (unsigned int i = 0; i < NumFingers; ++i) {
+		if (force[i] > max_force_ && (finger == NumFingers || force[i] > force[finger])) finger = i;
+	}
+	const bool above = finger < NumFingers;
+	if (above && !above_.load(std::memory_order_relaxed)) {
+		event_.store(Event{ force, finger, stamp.toSec() });
+		trips_.fetch_add(1, std::memory_order_relaxed);
+		pending_.store(true, std::memory_order_release);
+	}
+	above_.store(above, std::memory_order_release);
+}
+
+template <unsigned int NumFingers>
+inline void ForceLimit<NumFingers>::report(const ros::TimerEvent& /*event*/) {
+	const uint64_t trips = this->trips();
+	if (trips == reported_) return;
+
+	Event event;
+	if (!event_.tryLoad(event)) return;
+	std::ostringstream forces;
+	for (unsigned int i = 0; i < NumFingers; ++i) forces << (i ? ", " : "") << event.force[i];
+	ROS_WARN_STREAM_NAMED("KD45C", "Force limit of " << max_force_ << " exceeded by finger " << event.finger
+	                                                 << ", sample [" << forces.str() << "] at " << std::fixed
+	                                                 << event.stamp << "s, holding position. Trips: " << trips);
+	reported_ = trips;
+}
+}
+
+#endif  // KD45_CONTROLLER_FORCE_LIMIT_H
@@ -0,0 +1,106 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_GOAL_ADMISSION_H
+#define KD45_CONTROLLER_GOAL_ADMISSION_H
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+namespace kd45_controller {
+
+// admission control for incoming goals, non-realtime.
+// limits the rate of goals with a token bucket and counts goals that were rejected or coalesced.
+class GoalAdmission
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// reads the "admission" namespace
+	void init(ros::NodeHandle& nh) {
+		ros::NodeHandle admission_nh(nh, "admission");
+		admission_nh.param("max_goal_rate", max_rate_, 0.0);
+		admission_nh.param("burst", burst_, 1.0);
+		admission_nh.param("coalesce", coalesce_, false);
+		burst_ = std::max(burst_, 1.0);
+		tokens_ = burst_;
+		last_refill_ = Clock::now();
+	}
+
+	// takes a token, false if the goal exceeds the configured rate
+	bool admit() {
+		if (max_rate_ <= 0.0) return true;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		const Clock::time_point now = Clock::now();
+		tokens_ = std::min(burst_, tokens_ + max_rate_ * std::chrono::duration<double>(now - last_refill_).count());
+		last_refill_ = now;
+		if (tokens_ < 1.0) {
+			rejected_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		tokens_ -= 1.0;
+		return true;
+	}
+
+	bool coalesce() const { return coalesce_; }
+	void countCoalesced() { coalesced_.fetch_add(1, std::memory_order_relaxed); }
+
+	uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+	uint64_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+
+private:
+	double max_rate_ = 0.0;
+	double burst_ = 1.0;
+	bool coalesce_ = false;
+
+	std::mutex mutex_;
+	double tokens_ = 1.0;
+	Clock::time_point last_refill_;
+
+	std::atomic<uint64_t> rejected_{ 0 };
+	std::atomic<uint64_t> coalesced_{ 0 };
+};
+}
+
+#endif  // KD45_CONTROLLER_GOAL_ADMISSION_H
@@ -0,0 +1,188 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#ifndef KD45_CONTROLLER_GRASP_VERIFIER_H
+#define KD45_CONTROLLER_GRASP_VERIFIER_H
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include <error_string.h>
+#include <window_stats.h>
+
+namespace kd45_controller {
+
+// verifies a grasp after the fingers reached their goal: the forces of all fingers have to stay within bounds and
+// vary little over a window of samples before the goal succeeds. Gives up after a timeout. Only goals that close the
+// gripper are verified, opening it has to succeed without contact.
+template <unsigned int NumFingers>
+class GraspVerifier
+{
+public:
+	enum Result
+	{
+		PENDING,
+		VERIFIED,
+		FAILED,
+	};
+
+	// reads the "grasp_verification" namespace, the minimum force defaults to the contact threshold
+	void init(ros::NodeHandle& nh, double contact_threshold);
+	bool enabled() const { return enabled_; }
+	// time in s the forces have to be stable
+	double window() const { return window_; }
+
+	// non-realtime: true if a goal moving the fingers from start to goal positions closes the gripper, i.e. moves them
+	// further in the closing direction in sum
+	bool closes(const double* start, const double* goal) const;
+	// sign of the joint motion that closes the gripper
+	double closingDirection() const { return closing_direction_; }
+
+	// realtime, called every cycle once the goal reached its tolerances
+	Result update(const float* force, double dt);
+	// realtime, after update() returned PENDING: ends the verification with the samples so far, when the fingers
+	// move on before the window is full or the grasp is stable
+	Result finish() { return evaluate(true); }
+	// realtime, whenever the active goal changes: the next update() starts a new verification
+	void reset() { started_ = false; }
+
+	// realtime, describes the finger that failed the verification
+	void describe(ErrorString& error) const;
+
+private:
+	// VERIFIED if the forces in the windows are stable, PENDING otherwise unless failing is final
+	Result evaluate(bool final);
+
+	// samples in the window, 1s at 1kHz
+	static constexpr std::size_t kCapacity = 1024;
+
+	bool enabled_ = false;
+	double window_ = 0.2;
+	double timeout_ = 1.0;
+	double min_force_ = 0.1;
+	double max_force_ = std::numeric_limits<double>::infinity();
+	double max_variation_ = 0.05;
+	double closing_direction_ = -1.0;
+
+	// realtime state
+	bool started_ = false;
+	double elapsed_ = 0.0;
+	std::array<WindowStats<float, kCapacity>, NumFingers> windows_;
+	unsigned int failed_finger_ = 0;
+	typename WindowStats<float, kCapacity>::Summary failed_summary_{};
+};
+
+template <unsigned int NumFingers>
+inline void GraspVerifier<NumFingers>::init(ros::NodeHandle& nh, double contact_threshold) {
+	ros::NodeHandle verification_nh(nh, "grasp_verification");
+	verification_nh.param("enabled", enabled_, false);
+	verification_nh.param("window", window_, 0.2);
+	verification_nh.param("timeout", timeout_, 1.0);
+	verification_nh.param("min_force", min_force_, contact_threshold);
+	verification_nh.param("max_force", max_force_, std::numeric_limits<double>::infinity());
+	verification_nh.param("max_variation", max_variation_, 0.05);
+	verification_nh.param("closing_direction", closing_direction_, -1.0);
+	closing_direction_ = closing_direction_ < 0.0 ? -1.0 : 1.0;
+	if (timeout_ < window_) {
+		ROS_WARN_STREAM_NAMED("KD45C", "Grasp verification timeout is shorter than the window, using " << window_ << "s");
+		timeout_ = window_;
+	}
+	reset();
+	if (!enabled_) return;
+
+	ROS_INFO_STREAM_NAMED("KD45C", "Grasp verification enabled, forces in [" << min_force_ << ", " << max_force_
+	                                                                         << "] for " << window_ << "s");
+}
+
+template <unsigned int NumFingers>
+inline bool GraspVerifier<NumFingers>::closes(const double* start, const double* goal) const {
+	double closing = 0.0;
+	for (unsigned int i = 0; i < NumFingers; ++i) closing += closing_direction_ * (goal[i] - start[i]);
+	return closing > 0.0;
+}
+
+template <unsigned int NumFingers>
+inline typename GraspVerifier<NumFingers>::Result GraspVerifier<NumFingers>::update(const float* force, double dt) {
+	if (!started_) {
+		// windows longer than the buffer are shortened
+		started_ = true;
+		elapsed_ = 0.0;
+		const std::size_t length = dt > 0.0 ? static_cast<std::size_t>(std::ceil(window_ / dt)) : kCapacity;
+		for (auto& window : windows_) window.resize(length);
+	}
+
+	for (unsigned int i = 0; i < NumFingers; ++i) windows_[i].push(force[i]);
+	elapsed_ += dt;
+	if (!windows_[0].full()) return PENDING;
+	return evaluate(elapsed_ >= timeout_);
+}
+
+template <unsigned int NumFingers>
+inline typename GraspVerifier<NumFingers>::Result GraspVerifier<NumFingers>::evaluate(bool final) {
+	for (unsigned int i = 0; i < NumFingers; ++i) {
+		const typename WindowStats<float, kCapacity>::Summary summary = windows_[i].summary();
+		const bool stable = summary.min >= min_force_ && summary.max <= max_force_ &&
+		                    summary.max - summary.min <= max_variation_;
+		if (stable) continue;
+		if (!final) return PENDING;
+
+		failed_finger_ = i;
+		failed_summary_ = summary;
+		reset();
+		return FAILED;
+	}
+
+	reset();
+	return VERIFIED;
+}
+
+template <unsigned int NumFingers>
+inline void GraspVerifier<NumFingers>::describe(ErrorString& error) const {
+	error.format("Grasp verification failed: force of finger %u between %.3f and %.3f (mean %.3f) in the last %zu "
+	             "samples, expected within [%g, %g] varying by at most %g",
+	             failed_finger_, failed_summary_.min, failed_summary_.max, failed_summary_.mean,
+	             windows_[failed_finger_].size(), min_force_, max_force_, max_variation_);
+}
+}
+
+#endif  // KD45_CONTROLLER_GRASP_VERIFIER_H
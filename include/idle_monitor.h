@@ -0,0 +1,122 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#ifndef KD45_CONTROLLER_IDLE_MONITOR_H
+#define KD45_CONTROLLER_IDLE_MONITOR_H
+
+#include <ros/ros.h>
+
+#include <array>
+#include <cmath>
+
+namespace kd45_controller {
+
+// decides when the controller may do less work: it holds a finished trajectory and the tactile forces did not
+// change for a while. Any change of the contact state or a force change above a threshold ends the idle mode. The
+// forces are the range of all samples since the last cycle, so short events between two cycles count as well.
+template <unsigned int NumFingers>
+class IdleMonitor
+{
+public:
+	// reads the "idle" namespace
+	void init(ros::NodeHandle& nh);
+	bool enabled() const { return enabled_; }
+
+	void reset();
+
+	// realtime, every cycle. holding: nothing is to be done besides holding the current desired state. min_force and
+	// max_force: range of the samples since the last cycle. Returns true while idle
+	bool update(bool holding, const float* min_force, const float* max_force, double contact_threshold, double dt);
+	bool idle() const { return idle_; }
+
+private:
+	bool enabled_ = false;
+	double delay_ = 0.5;
+	double force_change_ = 0.05;
+
+	// realtime state
+	bool idle_ = false;
+	double quiet_for_ = 0.0;
+	// forces when the controller started holding, or at the last tactile event
+	std::array<float, NumFingers> reference_{};
+};
+
+template <unsigned int NumFingers>
+inline void IdleMonitor<NumFingers>::init(ros::NodeHandle& nh) {
+	ros::NodeHandle idle_nh(nh, "idle");
+	idle_nh.param("enabled", enabled_, false);
+	idle_nh.param("delay", delay_, 0.5);
+	idle_nh.param("force_change", force_change_, 0.05);
+	reset();
+	if (!enabled_) return;
+
+	ROS_INFO_STREAM_NAMED("KD45C", "Idle mode enabled after holding for " << delay_ << "s");
+}
+
+template <unsigned int NumFingers>
+inline void IdleMonitor<NumFingers>::reset() {
+	idle_ = false;
+	quiet_for_ = 0.0;
+	reference_.fill(0.0f);
+}
+
+template <unsigned int NumFingers>
+inline bool IdleMonitor<NumFingers>::update(bool holding, const float* min_force, const float* max_force,
+                                            double contact_threshold, double dt) {
+	bool event = !enabled_ || !holding;
+	for (unsigned int i = 0; i < NumFingers && !event; ++i) {
+		const bool contact = reference_[i] > contact_threshold;
+		event = (min_force[i] > contact_threshold) != contact || (max_force[i] > contact_threshold) != contact ||
+		        std::abs(min_force[i] - reference_[i]) > force_change_ ||
+		        std::abs(max_force[i] - reference_[i]) > force_change_;
+	}
+	if (event) {
+		for (unsigned int i = 0; i < NumFingers; ++i) reference_[i] = 0.5f * (min_force[i] + max_force[i]);
+		quiet_for_ = 0.0;
+		idle_ = false;
+		return false;
+	}
+
+	quiet_for_ += dt;
+	idle_ = quiet_for_ >= delay_;
+	return idle_;
+}
+}
+
+#endif  // KD45_CONTROLLER_IDLE_MONITOR_H
@@ -0,0 +1,124 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_IMPEDANCE_H
+#define KD45_CONTROLLER_IMPEDANCE_H
+
+#include <ros/ros.h>
+#include <Eigen/Core>
+
+#include <vector>
+
+namespace kd45_controller {
+
+// per-finger impedance law for effort controlled fingers.
+// the fingers behave like a spring-damper around the desired trajectory. once the measured contact force exceeds
+// max_force, the effort pushing into the object is reduced proportional to the excess force.
+template <class Scalar, int N>
+struct ImpedanceParameters
+{
+	// unaligned, the parameters live inside heap allocated controllers and realtime buffers
+	typedef Eigen::Array<Scalar, N, 1, Eigen::DontAlign> Vector;
+
+	bool enabled = false;
+	Vector stiffness = Vector::Zero();
+	Vector damping = Vector::Zero();
+	Scalar max_force = 0.0;
+	Scalar force_gain = 0.0;
+};
+
+namespace internal {
+// reads either a single value for all fingers or one value per finger
+template <class Vector>
+inline bool getPerFingerParam(ros::NodeHandle& nh, const std::string& name, Vector& value) {
+	std::vector<double> values;
+	double single = 0.0;
+	if (nh.getParam(name, values)) {
+		if (values.size() != static_cast<size_t>(value.size())) {
+			ROS_ERROR_STREAM_NAMED("KD45C", "Parameter " << name << " needs " << value.size() << " entries, got "
+			                                             << values.size());
+			return false;
+		}
+		for (int i = 0; i < value.size(); i++) value[i] = values[i];
+		return true;
+	} else if (nh.getParam(name, single)) {
+		value.setConstant(single);
+		return true;
+	}
+	return false;
+}
+}
+
+// reads the impedance parameters from the "impedance" namespace, non-realtime
+template <class Scalar, int N>
+inline bool loadImpedanceParameters(ros::NodeHandle& nh, ImpedanceParameters<Scalar, N>& params) {
+	ros::NodeHandle impedance_nh(nh, "impedance");
+
+	double max_force = 0.0, force_gain = 0.0;
+	impedance_nh.param("enabled", params.enabled, false);
+	impedance_nh.param("max_force", max_force, 0.0);
+	impedance_nh.param("force_gain", force_gain, 0.0);
+	params.max_force = max_force;
+	params.force_gain = force_gain;
+
+	if (!params.enabled) return true;
+
+	if (!internal::getPerFingerParam(impedance_nh, "stiffness", params.stiffness) ||
+	    !internal::getPerFingerParam(impedance_nh, "damping", params.damping)) {
+		ROS_ERROR_NAMED("KD45C", "Impedance control needs stiffness and damping, disabling it.");
+		params.enabled = false;
+		return false;
+	}
+	return true;
+}
+
+// computes the finger efforts from the tracking error and the measured contact forces, realtime safe
+template <class Scalar, int N, class ForceVector>
+inline void computeImpedanceEffort(const ImpedanceParameters<Scalar, N>& params,
+                                   const typename ImpedanceParameters<Scalar, N>::Vector& position_error,
+                                   const typename ImpedanceParameters<Scalar, N>::Vector& velocity_error,
+                                   const ForceVector& force, typename ImpedanceParameters<Scalar, N>::Vector& effort) {
+	effort = params.stiffness * position_error + params.damping * velocity_error;
+
+	// back off in the direction we are pushing into the object
+	const typename ImpedanceParameters<Scalar, N>::Vector excess = (force - params.max_force).max(Scalar(0.0));
+	effort -= position_error.sign() * params.force_gain * excess;
+}
+}
+
+#endif  // KD45_CONTROLLER_IMPEDANCE_H
@@ -40,27 +40,363 @@
 
 #include <joint_trajectory_controller/joint_trajectory_controller.h>
 #include <trajectory_interface/quintic_spline_segment.h>
+#include <cubic_spline_segment.h>
+#include <linear_segment.h>
 
 #include <joint_trajectory_controller/joint_trajectory_segment.h>
+#include <control_msgs/QueryTrajectoryState.h>
+#include <trajectory_msgs/JointTrajectoryPoint.h>
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include <active_goal.h>
+#include <goal_admission.h>
+#include <idle_monitor.h>
+#include <impedance.h>
+#include <latency_budget.h>
+#include <epoch_domain.h>
+#include <error_string.h>
+#include <fault_detector.h>
+#include <force_channel.h>
+#include <force_limit.h>
+#include <grasp_verifier.h>
+#include <mailbox.h>
+#include <message_stats.h>
+#include <seqlock.h>
+#include <spsc_queue.h>
+#include <state_snapshot.h>
+#include <tactile_summary.h>
+#include <velocity_observer.h>
 
 namespace kd45_controller {
 
-template <class TactileSensors>
+// the KD45 has two fingers with one tactile pad each
+constexpr unsigned int kNumFingers = 2;
+
+// latest force per finger, written by the tactile sensor and read by the control loop
+typedef std::array<float, kNumFingers> Forces;
+
+template <class TactileSensors, class HardwareInterface = hardware_interface::PositionJointInterface,
+          class SegmentImpl = trajectory_interface::QuinticSplineSegment<double>>
 class KD45TrajectoryController
-    : public joint_trajectory_controller::JointTrajectoryController<trajectory_interface::QuinticSplineSegment<double>,
-                                                                    hardware_interface::PositionJointInterface>
+    : public joint_trajectory_controller::JointTrajectoryController<SegmentImpl, HardwareInterface>
 {
-	bool init(hardware_interface::PositionJointInterface* hw, ros::NodeHandle& root_nh,
-	          ros::NodeHandle& controller_nh) override;
+	typedef joint_trajectory_controller::JointTrajectoryController<SegmentImpl, HardwareInterface>
+	    JointTrajectoryController;
+
+	typedef typename JointTrajectoryController::GoalHandle GoalHandle;
+	typedef typename JointTrajectoryController::JointTrajectoryConstPtr JointTrajectoryConstPtr;
+	typedef typename JointTrajectoryController::RealtimeGoalHandle RealtimeGoalHandle;
+	typedef typename JointTrajectoryController::RealtimeGoalHandlePtr RealtimeGoalHandlePtr;
+	typedef typename JointTrajectoryController::Trajectory Trajectory;
+	typedef typename JointTrajectoryController::TrajectoryPtr TrajectoryPtr;
+	typedef typename JointTrajectoryController::Segment Segment;
+	typedef typename JointTrajectoryController::TrajectoryPerJoint TrajectoryPerJoint;
+	typedef typename JointTrajectoryController::TimeData TimeData;
+	typedef typename JointTrajectoryController::Scalar Scalar;
+
+	bool init(HardwareInterface* hw, ros::NodeHandle& root_nh, ros::NodeHandle& controller_nh) override;
 
 	void goalCB(GoalHandle gh) override;
+	void trajectoryCommandCB(const JointTrajectoryConstPtr& msg) override;
+	void cancelCB(GoalHandle gh) override;
+	void starting(const ros::Time& time) override;
+	void stopping(const ros::Time& time) override;
 	void update(const ros::Time& time, const ros::Duration& period) override;
 
 protected:
+    // the base class is a dependent type now, pull in what we use from it
+    using JointTrajectoryController::action_monitor_period_;
+    using JointTrajectoryController::allow_partial_joints_goal_;
+    using JointTrajectoryController::controller_nh_;
+    using JointTrajectoryController::curr_trajectory_box_;
+    using JointTrajectoryController::current_state_;
+    using JointTrajectoryController::desired_joint_state_;
+    using JointTrajectoryController::desired_state_;
+    using JointTrajectoryController::goal_handle_timer_;
+    using JointTrajectoryController::hold_trajectory_ptr_;
+    using JointTrajectoryController::hw_iface_adapter_;
+    using JointTrajectoryController::joint_names_;
+    using JointTrajectoryController::joints_;
+    using JointTrajectoryController::query_state_service_;
+    using JointTrajectoryController::realtime_busy_;
+    using JointTrajectoryController::state_error_;
+    using JointTrajectoryController::state_joint_error_;
+    using JointTrajectoryController::stop_trajectory_duration_;
+    using JointTrajectoryController::successful_joint_traj_;
+    using JointTrajectoryController::time_data_;
+    using JointTrajectoryController::verbose_;
+
+    using JointTrajectoryController::isRunning;
+    using JointTrajectoryController::publishState;
+    using JointTrajectoryController::setHoldPosition;
+
     typedef std::shared_ptr<TactileSensors> TactileSensorsPtr;
+    typedef ImpedanceParameters<Scalar, kNumFingers> Impedance;
+
+    // realtime goal handle with a copy of the goal ID and an error description, so the control loop can export the
+    // ID and describe failures without allocating
+    struct TrackedGoalHandle : public RealtimeGoalHandle
+    {
+        explicit TrackedGoalHandle(GoalHandle& gh) : RealtimeGoalHandle(gh) {
+            std::strncpy(goal_id, gh.getGoalID().id.c_str(), kGoalIdSize - 1);
+            goal_id[kGoalIdSize - 1] = '\0';
+        }
+
+        // realtime, once error and the error code of the result are set. the abort is handed to the goal timer
+        // instead of the base class, which could send the result before the description is copied to it
+        void requestAbort() { abort_requested.store(true, std::memory_order_release); }
+
+        // copies the error description to the result and aborts the goal in the same thread that sends the result
+        void runNonRealtime(const ros::TimerEvent& event) {
+            if (abort_requested.exchange(false, std::memory_order_acquire)) {
+                this->preallocated_result_->error_string = error.c_str();
+                RealtimeGoalHandle::setAborted(this->preallocated_result_);
+            }
+            RealtimeGoalHandle::runNonRealtime(event);
+        }
+
+        char goal_id[kGoalIdSize];
+        ErrorString error;
+        std::atomic<bool> abort_requested{ false };
+        // set by the realtime loop along with the result, the goal is not canceled anymore then
+        std::atomic<bool> finished{ false };
+        // set before the goal is handed to the realtime loop
+        bool verify_grasp = false;
+        Impedance impedance;
+    };
+
+    // all goal handles are created by processGoal()
+    static TrackedGoalHandle& tracked(RealtimeGoalHandle& goal) { return static_cast<TrackedGoalHandle&>(goal); }
+    static bool unfinished(const RealtimeGoalHandlePtr& goal) { return goal && !tracked(*goal).finished.load(); }
+
+    // desired and measured joint state of the last realtime cycle, to hold position from non-realtime threads
+    struct JointStateSample
+    {
+        Scalar desired_position[kSnapshotMaxJoints];
+        Scalar desired_velocity[kSnapshotMaxJoints];
+        Scalar position[kSnapshotMaxJoints];
+    };
+
+    // loads a value the realtime loop stores once per cycle, non-realtime
+    template <class T>
+    static T loadPublished(const SeqLock<T>& published);
+    // the time data of the last realtime cycle, non-realtime
+    TimeData loadTimeData() const { return loadPublished(published_time_data_); }
+    // stores the joint state of this cycle, realtime
+    void publishJointState();
+    // same as the base class, with the time data of the realtime loop
+    bool queryStateService(control_msgs::QueryTrajectoryState::Request& req,
+                           control_msgs::QueryTrajectoryState::Response& resp);
+
+    // publishes every trajectory installed by the base class to the realtime loop
+    bool updateTrajectoryCommand(const JointTrajectoryConstPtr& msg, RealtimeGoalHandlePtr gh,
+                                 std::string* error_string = 0) override;
+    // hands the current trajectory of the box to the realtime loop, non-realtime with trajectory_mutex_ held
+    void publishTrajectory();
+    // the base class modifies the hold trajectory in place, the realtime loop may still follow it. this swaps in a
+    // copy to be modified instead and returns the previous one, to be retired once the new one is published
+    TrajectoryPtr detachHoldTrajectory();
+    // holds the current position from a non-realtime thread
+    void holdPosition();
+    // the same with trajectory_mutex_ held, the hold segments belong to gh
+    void holdPositionLocked(const RealtimeGoalHandlePtr& gh = RealtimeGoalHandlePtr());
+    // setHoldPosition() of the base class on the joint state published by the realtime loop, instead of the joint
+    // handles and desired state the loop writes meanwhile
+    void setHoldTrajectory(const ros::Time& time, const RealtimeGoalHandlePtr& gh);
+    // non-realtime housekeeping at the action monitor rate
+    void monitorCB(const ros::TimerEvent& event);
+
+    // freezes the command at the current position when the sensor tripped the force limit, realtime. returns true
+    // while the command is frozen, until a trajectory is published that opens the gripper or comes after the forces
+    // went back below the limit
+    bool updateForceLimit(const Trajectory& curr_traj, uint64_t trajectory_version, const ros::Time& sample_time);
+    // true if a segment of trajectory after sample_time moves a finger beyond the frozen and the actual position in
+    // closing direction, realtime. goal is set to the goal of the first such segment, null if it has none
+    bool closesFrozenGripper(const Trajectory& trajectory, const ros::Time& sample_time, RealtimeGoalHandle*& goal);
+    // freezes the command at the current position until the next trajectory is published, realtime
+    void freezePosition();
+    // commands the frozen position, overriding the trajectory sampled in this cycle
+    void holdFrozenPosition();
+
+    // writes the commands for the desired state and errors of this cycle, realtime
+    void writeCommand(const TimeData& time_data);
+    // the minimal cycle while idle: reads the joints and commands the constant desired state of the last full cycle
+    void updateHolding(const TimeData& time_data, const LatencyBudget::Clock::time_point& cycle_start);
+
+    // exports the state of this cycle to shared memory, realtime
+    void writeStateSnapshot(const ros::Time& uptime, const LatencyBudget::Clock::time_point& cycle_start);
+
+    // writes the impedance law efforts directly to the joints, effort interface only
+    void updateImpedanceCommand(const Impedance& impedance);
 
-    std::shared_ptr<std::vector<float>> forces_;
+    // a streamed setpoint, positions (and optionally velocities) in controller joint order
+    struct StreamSetpoint
+    {
+        std::array<Scalar, kNumFingers> position;
+        std::array<Scalar, kNumFingers> velocity;
+        Scalar blend_time;
+        unsigned int generation;
+    };
+    typedef CubicSplineSegment<Scalar> StreamSegment;
+
+    // validates and installs a goal that passed admission control
+    void processGoal(GoalHandle gh);
+    void processPendingGoal(const ros::TimerEvent& event);
+    // non-realtime: installs next (or no goal) for the realtime loop and cancels the goals it replaces, the active one
+    // and the ones queued behind it
+    void preemptGoal(const RealtimeGoalHandlePtr& next = RealtimeGoalHandlePtr());
+    // non-realtime: true while the installed goal or a goal queued behind it has not finished
+    bool hasUnfinishedGoal();
+    // non-realtime: true if the goal closes the gripper, starting from the current position or after the current
+    // trajectory when appended
+    bool closesGripper(const trajectory_msgs::JointTrajectory& msg, const std::vector<unsigned int>& mapping,
+                       bool append);
+    // realtime: the goal checks start over whenever the active goal changes
+    void resetGoalChecks();
+
+    // a goal waiting behind the active one in append mode
+    struct QueuedGoal
+    {
+        RealtimeGoalHandlePtr goal;
+        unsigned int generation;
+    };
+
+    // shifts msg to start at the end of the current trajectory, false if there is nothing to append to
+    bool appendToCurrentTrajectory(JointTrajectoryConstPtr& msg);
+    void pruneQueuedGoalTimers();
+    // realtime: marks the joint successful once it is inside the goal tolerances of the last segment of the goal,
+    // aborts the goal once the goal time tolerance has passed
+    void checkGoalTolerances(RealtimeGoalHandle& goal, unsigned int joint, const Segment& last_segment,
+                             const typename Segment::State& error, const ros::Time& sample_time);
+
+    // realtime side of the goal queue
+    void activateQueuedGoal(RealtimeGoalHandle* rt_segment_goal);
+    void dropStaleQueuedGoals();
+    // false if there were no queued goals to abort
+    bool abortQueuedGoals(int32_t error_code, const ErrorString& reason);
+    // realtime: aborts the goal with the description in its error, and the goals queued behind it
+    void abortGoal(RealtimeGoalHandle& goal, int32_t error_code);
+
+    void streamCommandCB(const trajectory_msgs::JointTrajectoryPointConstPtr& msg);
+    // ends streaming before a trajectory is installed, so it starts from the actual joint positions
+    void stopStreaming();
+    // consumes streamed setpoints and blends towards the latest one, realtime
+    void updateStream(const ros::Time& sample_time);
+
+    std::shared_ptr<ForceChannel<kNumFingers>> forces_;
+    // realtime copy of the summary of the samples since the last cycle and of the latest forces, kept if the sensor
+    // is writing while they are read
+    typename ForceChannel<kNumFingers>::Summary rt_force_summary_{};
+    unsigned int rt_force_samples_ = 0;
+    Forces rt_forces_{};
     TactileSensorsPtr sensors_;
+    TactileSummaryPublisher<kNumFingers> tactile_summary_;
+    // force above which a finger is considered in contact
+    double contact_threshold_ = 0.1;
+
+    FaultDetector<Scalar, kNumFingers> fault_detector_;
+    // checked by the sensor at its own rate, the realtime loop only picks up trips. the command is frozen as well when
+    // a goal sequence is aborted, until the hold trajectory requested from the monitor timer is published
+    std::shared_ptr<ForceLimit<kNumFingers>> force_limit_;
+    bool force_frozen_ = false;
+    uint64_t force_frozen_version_ = 0;
+    std::vector<Scalar> force_frozen_position_;
+    typename Segment::State force_frozen_sample_;
+    // trajectory version + 1 to replace by a hold trajectory, 0 if none
+    std::atomic<uint64_t> hold_request_{ 0 };
+    ros::Timer monitor_timer_;
+    GraspVerifier<kNumFingers> grasp_verifier_;
+
+    // reduced work while holding a finished trajectory without tactile events: update() takes the minimal path of
+    // updateHolding(). holding_ is determined by the last full cycle, for the trajectory version it followed
+    IdleMonitor<kNumFingers> idle_monitor_;
+    bool idle_ = false;
+    bool holding_ = false;
+    uint64_t holding_version_ = 0;
+
+    // state exported to shared memory for external monitors
+    StateSnapshotWriter<kNumFingers> state_shm_;
+    StateSnapshot<kNumFingers> snapshot_{};
+
+    LatencyBudget latency_budget_;
+    // overrun totals last reported by the monitor timer
+    uint64_t latency_reported_overruns_ = 0;
+    uint64_t latency_reported_skipped_ = 0;
+
+    // actuation delay compensation: sample the trajectory ahead and predict the measured state forward
+    bool delay_compensation_ = false;
+    ros::Duration actuation_delay_;
+    VelocityObserver<Scalar> velocity_observer_;
+
+    // reclaims the values replaced in the mailboxes below, the realtime loop enters a new epoch every cycle
+    EpochDomain epoch_domain_;
+
+    // time data of the realtime loop. the buffer of the base class takes a lock on every access, it is only kept up to
+    // date for the base class by updateTrajectoryCommand() now
+    ros::Time rt_uptime_;
+    SeqLock<TimeData> published_time_data_;
+    SeqLock<JointStateSample> published_joint_state_;
+
+    // the trajectory followed by the realtime loop. the box of the base class stays the non-realtime source of truth,
+    // every change to it is published here so the realtime loop never contends for its lock
+    std::mutex trajectory_mutex_;
+    Mailbox<TrajectoryPtr> trajectory_mailbox_{ epoch_domain_ };
+    // the hold trajectory set up by starting(), followed until the next trajectory is published
+    Trajectory* starting_trajectory_ = nullptr;
+    uint64_t starting_version_ = 0;
+
+    // impedance parameters of the goal the realtime loop follows, each goal carries the parameters read when it was
+    // accepted. realtime, only written by init() before that
+    bool impedance_available_ = false;
+    Impedance rt_impedance_;
+
+    // the goal followed by the realtime loop, instead of the active goal of the base class that both sides would write.
+    // goal_mutex_ serializes preemption and guards queued_goal_timers_
+    ActiveGoal<RealtimeGoalHandlePtr> active_goal_{ epoch_domain_ };
+    std::mutex goal_mutex_;
+
+    GoalAdmission goal_admission_;
+    // totals last reported by the monitor timer
+    uint64_t admission_reported_rejected_ = 0;
+    uint64_t admission_reported_coalesced_ = 0;
+    std::mutex pending_goal_mutex_;
+    GoalHandle pending_goal_;
+    bool has_pending_goal_ = false;
+    ros::Timer pending_goal_timer_;
+
+    // goals appended behind the active one, handed to the realtime loop in a preallocated ring. their timers keep them
+    // alive for the realtime loop once activated
+    bool goal_queue_enabled_ = false;
+    SpscQueue<QueuedGoal, 16> goal_queue_;
+    std::atomic<unsigned int> goal_queue_generation_{ 0 };
+    std::vector<std::pair<RealtimeGoalHandlePtr, ros::Timer>> queued_goal_timers_;
+    // the end state of the active goal, to check its goal tolerances once a queued goal is reached
+    typename Segment::State goal_end_state_;
+    typename Segment::State goal_end_error_;
+
+    // streaming setpoint input, setpoints are handed to the realtime loop through a lock-free queue
+    bool stream_available_ = false;
+    double stream_blend_time_ = 0.0;
+    double stream_max_blend_time_ = 0.0;
+    ros::Subscriber stream_sub_;
+    SpscQueue<StreamSetpoint, 16> stream_queue_;
+    std::atomic<bool> streaming_{ false };
+    std::atomic<unsigned int> stream_generation_{ 0 };
+
+    // realtime side of the stream. once the blend to the last setpoint has ended, its position is held at rest until
+    // the next setpoint or trajectory
+    bool stream_active_ = false;
+    bool stream_holding_ = false;
+    uint64_t stream_trajectory_version_ = 0;
+    unsigned int stream_active_generation_ = 0;
+    StreamSegment stream_segment_;
+    typename StreamSegment::State stream_start_state_;
+    typename StreamSegment::State stream_end_state_;
+    typename StreamSegment::State stream_state_;
 
     std::string name_ = "KD45C";
 };
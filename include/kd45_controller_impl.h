@@ -38,45 +38,408 @@
 #ifndef KD45_CONTROLLER_KD45_CONTROLLER_IMPL_H
 #define KD45_CONTROLLER_KD45_CONTROLLER_IMPL_H
 
+#include <algorithm>
 #include <numeric>
 #include <chrono>
+#include <iterator>
 #include <math.h>
 #include "kd45_controller.h"
 #include <type_traits>
 #include <cmath>
+#include <sstream>
+#include <thread>
 
 namespace kd45_controller {
-template <class TactileSensors>
-inline bool KD45TrajectoryController<TactileSensors>::init(hardware_interface::PositionJointInterface* hw,
-                                                           ros::NodeHandle& root_nh, ros::NodeHandle& controller_nh) {
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::init(
+    HardwareInterface* hw, ros::NodeHandle& root_nh, ros::NodeHandle& controller_nh) {
     ROS_INFO_NAMED(name_, "Initializing KD45TrajectoryController.");
-    forces_= std::make_shared<std::vector<float>>(2, 0.0);
-    sensors_ = std::make_shared<TactileSensors>(root_nh, forces_);
+    forces_ = std::make_shared<ForceChannel<kNumFingers>>();
+    force_limit_ = std::make_shared<ForceLimit<kNumFingers>>();
+    force_limit_->init(controller_nh);
+    sensors_ = std::make_shared<TactileSensors>(root_nh, forces_, force_limit_);
+	controller_nh.param("contact_threshold", contact_threshold_, 0.1);
+	tactile_summary_.init(controller_nh, forces_, contact_threshold_);
+
+	fault_detector_.init(controller_nh);
+	grasp_verifier_.init(controller_nh, contact_threshold_);
+	idle_monitor_.init(controller_nh);
+
+	std::string state_shm_name;
+	controller_nh.param<std::string>("state_shm/name", state_shm_name, "");
+	if (!state_shm_name.empty() && state_shm_.open(state_shm_name)) {
+		ROS_INFO_STREAM_NAMED(name_, "Exporting the controller state to shared memory \"" << state_shm_name << "\"");
+	}
+	latency_budget_.init(controller_nh);
+	goal_admission_.init(controller_nh);
 
 	bool ret = JointTrajectoryController::init(hw, root_nh, controller_nh);
+	if (ret && joints_.size() > kSnapshotMaxJoints) {
+		ROS_ERROR_STREAM_NAMED(name_, "At most " << kSnapshotMaxJoints << " joints are supported.");
+		return false;
+	}
+
+	// The service of the base class reads the time data from a buffer the realtime loop does not write anymore
+	query_state_service_.shutdown();
+	query_state_service_ =
+	    controller_nh.advertiseService("query_state", &KD45TrajectoryController::queryStateService, this);
+
+	// Replaced trajectories and parameters are freed outside of the control loop
+	epoch_domain_.startReclaimer(std::chrono::milliseconds(10));
+
+	double delay = 0.0, observer_gain = 1.0;
+	controller_nh.param("delay_compensation/delay", delay, 0.0);
+	controller_nh.param("delay_compensation/observer_gain", observer_gain, 1.0);
+	delay_compensation_ = delay > 0.0;
+	actuation_delay_ = ros::Duration(delay_compensation_ ? delay : 0.0);
+	velocity_observer_.init(joints_.size(), std::min(std::max(observer_gain, 0.0), 1.0));
+	force_frozen_position_.resize(joints_.size());
+	force_frozen_sample_ = typename Segment::State(1);
+	if (delay_compensation_) {
+		ROS_INFO_STREAM_NAMED(name_, "Compensating an actuation delay of " << delay << "s");
+	}
+
+	// the impedance law commands efforts and uses fixed-size math, one joint per finger
+	impedance_available_ =
+	    std::is_same<HardwareInterface, hardware_interface::EffortJointInterface>::value && joints_.size() == kNumFingers;
+	rt_impedance_ = Impedance();
+	if (impedance_available_) loadImpedanceParameters(controller_nh, rt_impedance_);
+
+	controller_nh.param("goal_queue/enabled", goal_queue_enabled_, false);
+	goal_end_state_ = typename Segment::State(1);
+	goal_end_error_ = typename Segment::State(1);
+	monitor_timer_ = controller_nh.createTimer(action_monitor_period_, &KD45TrajectoryController::monitorCB, this);
+
+	// streamed setpoints are blended with a cubic segment, preallocated here so blending does not allocate
+	stream_available_ = joints_.size() == kNumFingers;
+	controller_nh.param("stream/blend_time", stream_blend_time_, 0.02);
+	controller_nh.param("stream/max_blend_time", stream_max_blend_time_, 0.1);
+	stream_max_blend_time_ = std::isfinite(stream_max_blend_time_) ? std::max(stream_max_blend_time_, 0.0) : 0.0;
+	stream_blend_time_ = std::isfinite(stream_blend_time_) ? std::max(stream_blend_time_, 0.0) : 0.0;
+	stream_start_state_ = typename StreamSegment::State(kNumFingers);
+	stream_end_state_ = typename StreamSegment::State(kNumFingers);
+	stream_state_ = typename StreamSegment::State(kNumFingers);
+	stream_segment_.init(0.0, stream_start_state_, 0.0, stream_end_state_);
+	if (stream_available_) {
+		stream_sub_ = controller_nh.subscribe("stream_command", 1, &KD45TrajectoryController::streamCommandCB, this,
+		                                      ros::TransportHints().tcpNoDelay());
+	}
+
 	return ret;
 }
 
-template <class TactileSensors>
-inline void KD45TrajectoryController<TactileSensors>::goalCB(GoalHandle gh) {
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::starting(
+    const ros::Time& time) {
+	JointTrajectoryController::starting(time);
+	const TimeData time_data = *time_data_.readFromRT();
+	rt_uptime_ = time_data.uptime;
+	published_time_data_.store(time_data);
+	for (unsigned int i = 0; i < joints_.size(); ++i) current_state_.position[i] = joints_[i].getPosition();
+	publishJointState();
+	velocity_observer_.reset();
+	fault_detector_.reset();
+	grasp_verifier_.reset();
+	idle_monitor_.reset();
+	idle_ = false;
+	holding_ = false;
+
+	// The base class installed the hold trajectory without going through the mailbox
+	starting_trajectory_ = hold_trajectory_ptr_.get();
+	starting_version_ = trajectory_mailbox_.version();
+
+	// Trips while stopped are stale, the hold trajectory keeps the gripper where it is anyway
+	force_limit_->consumeTrip();
+	force_frozen_ = false;
+	force_frozen_version_ = starting_version_;
+	for (unsigned int i = 0; i < joints_.size(); ++i) force_frozen_position_[i] = joints_[i].getPosition();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::stopping(
+    const ros::Time& time) {
+	JointTrajectoryController::stopping(time);
+	preemptGoal();
+
+	// A stopped controller does not follow the stream anymore, setpoints arriving meanwhile are ignored
+	streaming_ = false;
+	stream_generation_++;
+	stream_active_ = false;
+	stream_holding_ = false;
+
+	// Values read by the realtime loop can be reclaimed while it is stopped
+	epoch_domain_.quiesce();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+template <class T>
+inline T KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::loadPublished(
+    const SeqLock<T>& published) {
+	// The realtime loop stores once per cycle, a collision with it is over after a few instructions
+	T value;
+	while (!published.tryLoad(value)) std::this_thread::yield();
+	return value;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::publishJointState() {
+	JointStateSample sample;
+	for (unsigned int i = 0; i < joints_.size(); ++i) {
+		sample.desired_position[i] = desired_state_.position[i];
+		sample.desired_velocity[i] = desired_state_.velocity[i];
+		sample.position[i] = current_state_.position[i];
+	}
+	published_joint_state_.store(sample);
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::queryStateService(
+    control_msgs::QueryTrajectoryState::Request& req, control_msgs::QueryTrajectoryState::Response& resp) {
+	// Preconditions
+	if (!this->isRunning()) {
+		ROS_ERROR_NAMED(name_, "Can't sample trajectory. Controller is not running.");
+		return false;
+	}
+
+	// Convert request time to internal monotonic representation
+	const TimeData time_data = loadTimeData();
+	const ros::Duration time_offset = req.time - time_data.time;
+	const ros::Time sample_time = time_data.uptime + time_offset;
+
+	// Sample trajectory at requested time
+	TrajectoryPtr curr_traj_ptr;
+	curr_trajectory_box_.get(curr_traj_ptr);
+	Trajectory& curr_traj = *curr_traj_ptr;
+
+	typename Segment::State response_point = typename Segment::State(joint_names_.size());
+	for (unsigned int i = 0; i < joints_.size(); ++i) {
+		typename Segment::State state;
+		typename TrajectoryPerJoint::const_iterator segment_it = sample(curr_traj[i], sample_time.toSec(), state);
+		if (curr_traj[i].end() == segment_it) {
+			ROS_ERROR_STREAM_NAMED(name_, "Requested sample time precedes trajectory start time.");
+			return false;
+		}
+
+		response_point.position[i] = state.position[0];
+		response_point.velocity[i] = state.velocity[0];
+		response_point.acceleration[i] = state.acceleration[0];
+	}
+
+	// Populate response
+	resp.name = joint_names_;
+	resp.position = response_point.position;
+	resp.velocity = response_point.velocity;
+	resp.acceleration = response_point.acceleration;
+	return true;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::updateTrajectoryCommand(
+    const JointTrajectoryConstPtr& msg, RealtimeGoalHandlePtr gh, std::string* error_string) {
+	std::lock_guard<std::mutex> lock(trajectory_mutex_);
+
+	// An empty trajectory holds position, the base class would read the state the realtime loop writes
+	if (msg && msg->points.empty() && this->isRunning()) {
+		holdPositionLocked(gh);
+		ROS_DEBUG_NAMED(name_, "Empty trajectory command, stopping.");
+		return true;
+	}
+
+	// The base class takes the start time of the trajectory from its buffer, only written here
+	time_data_.writeFromNonRT(loadTimeData());
+
+	const bool update_ok = JointTrajectoryController::updateTrajectoryCommand(msg, gh, error_string);
+	if (update_ok) publishTrajectory();
+	return update_ok;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::publishTrajectory() {
+	// Serialized by trajectory_mutex_, so a slower writer can not publish an older trajectory over a newer one
+	TrajectoryPtr curr_traj_ptr;
+	curr_trajectory_box_.get(curr_traj_ptr);
+	trajectory_mailbox_.publish(curr_traj_ptr);
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline typename KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::TrajectoryPtr
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::detachHoldTrajectory() {
+	TrajectoryPtr previous_hold = hold_trajectory_ptr_;
+	hold_trajectory_ptr_.reset(new Trajectory(*previous_hold));
+	return previous_hold;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::holdPosition() {
+	std::lock_guard<std::mutex> lock(trajectory_mutex_);
+	holdPositionLocked();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::holdPositionLocked(
+    const RealtimeGoalHandlePtr& gh) {
+	TrajectoryPtr previous_hold = detachHoldTrajectory();
+	setHoldTrajectory(loadTimeData().uptime, gh);
+	publishTrajectory();
+
+	// The realtime loop may still follow the previous hold trajectory, e.g. the one installed by starting()
+	epoch_domain_.retire([previous_hold] {});
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::setHoldTrajectory(
+    const ros::Time& time, const RealtimeGoalHandlePtr& gh) {
+	const JointStateSample joint_state = loadPublished(published_joint_state_);
+	typename Segment::State hold_start_state(1);
+	typename Segment::State hold_end_state(1);
+	const typename Segment::Time start_time = time.toSec();
+
+	if (stop_trajectory_duration_ == 0.0) {
+		// Stop at the current actual position
+		for (unsigned int i = 0; i < joints_.size(); ++i) {
+			hold_start_state.position[0] = joint_state.position[i];
+			hold_start_state.velocity[0] = 0.0;
+			hold_start_state.acceleration[0] = 0.0;
+			(*hold_trajectory_ptr_)[i].front().init(start_time, hold_start_state, start_time, hold_start_state);
+			(*hold_trajectory_ptr_)[i].front().setGoalHandle(gh);
+		}
+	} else {
+		// Settle in stop_trajectory_duration_: a segment from (pos, vel) to (pos, -vel) in twice the time has zero
+		// velocity at its midpoint, assuming it is symmetric. The hold segment goes from the current state to that
+		const typename Segment::Time end_time = start_time + stop_trajectory_duration_;
+		const typename Segment::Time end_time_2x = start_time + 2.0 * stop_trajectory_duration_;
+		for (unsigned int i = 0; i < joints_.size(); ++i) {
+			hold_start_state.position[0] = joint_state.desired_position[i];
+			hold_start_state.velocity[0] = joint_state.desired_velocity[i];
+			hold_start_state.acceleration[0] = 0.0;
+
+			hold_end_state.position[0] = joint_state.desired_position[i];
+			hold_end_state.velocity[0] = -joint_state.desired_velocity[i];
+			hold_end_state.acceleration[0] = 0.0;
+
+			Segment& hold_segment = (*hold_trajectory_ptr_)[i].front();
+			hold_segment.init(start_time, hold_start_state, end_time_2x, hold_end_state);
+			hold_segment.sample(end_time, hold_end_state);
+			hold_segment.init(start_time, hold_start_state, end_time, hold_end_state);
+			hold_segment.setGoalHandle(gh);
+		}
+	}
+	curr_trajectory_box_.set(hold_trajectory_ptr_);
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::monitorCB(
+    const ros::TimerEvent& /*event*/) {
+	// The realtime loop aborted a goal sequence and froze the command, unless a newer trajectory was installed since
+	const uint64_t hold_request = hold_request_.exchange(0);
+	if (hold_request) {
+		std::lock_guard<std::mutex> lock(trajectory_mutex_);
+		if (trajectory_mailbox_.version() + 1 == hold_request) holdPositionLocked();
+	}
+
+	// Goals turned away by admission control, the totals so far whenever they changed
+	const uint64_t rejected = goal_admission_.rejected();
+	const uint64_t coalesced = goal_admission_.coalesced();
+	if (rejected != admission_reported_rejected_ || coalesced != admission_reported_coalesced_) {
+		admission_reported_rejected_ = rejected;
+		admission_reported_coalesced_ = coalesced;
+		ROS_WARN_STREAM_THROTTLE_NAMED(10, name_, "Goal admission rejected " << rejected << " goals above the rate limit "
+		                                          "and coalesced " << coalesced << " goals so far");
+	}
+
+	// Cycles over the latency budget, counted once per cycle, plus the stages that ran over
+	uint64_t overruns = latency_budget_.cycleOverruns();
+	for (int i = 0; i < LatencyBudget::NUM_STAGES; ++i)
+		overruns += latency_budget_.stageOverruns(static_cast<LatencyBudget::Stage>(i));
+	const uint64_t skipped = latency_budget_.skippedCycles();
+	if (overruns != latency_reported_overruns_ || skipped != latency_reported_skipped_) {
+		latency_reported_overruns_ = overruns;
+		latency_reported_skipped_ = skipped;
+		std::ostringstream stages;
+		for (int i = 0; i < LatencyBudget::NUM_STAGES; ++i) {
+			const LatencyBudget::Stage stage = static_cast<LatencyBudget::Stage>(i);
+			stages << " " << LatencyBudget::stageName(stage) << " " << latency_budget_.stageOverruns(stage);
+		}
+		ROS_WARN_STREAM_THROTTLE_NAMED(10, name_, "Latency budget exceeded in " << latency_budget_.cycleOverruns()
+		                                          << " cycles, stages over budget:" << stages.str() << ", skipped "
+		                                          << skipped << " cycles so far");
+	}
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::goalCB(
+    GoalHandle gh) {
 	ROS_DEBUG_STREAM_NAMED(name_, "Received new action goal");
 
+	// Admission control: reject goals above the configured rate
+	if (!goal_admission_.admit()) {
+		ROS_WARN_THROTTLE_NAMED(1, name_, "Goal rate limit exceeded, rejecting goal.");
+		control_msgs::FollowJointTrajectoryResult result;
+		result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;
+		result.error_string = "Goal rate limit exceeded";
+		gh.setRejected(result);
+		return;
+	}
+
+	if (!goal_admission_.coalesce()) {
+		processGoal(gh);
+		return;
+	}
+
+	// Goals arriving within one control cycle are coalesced, only the last one is processed
+	std::lock_guard<std::mutex> lock(pending_goal_mutex_);
+	if (has_pending_goal_) {
+		control_msgs::FollowJointTrajectoryResult result;
+		result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;
+		result.error_string = "Coalesced with a newer goal";
+		pending_goal_.setRejected(result);
+		goal_admission_.countCoalesced();
+	} else {
+		const ros::Duration period = loadTimeData().period;
+		pending_goal_timer_ = controller_nh_.createTimer(period.isZero() ? ros::Duration(0.001) : period,
+		                                                 &KD45TrajectoryController::processPendingGoal, this, true);
+	}
+	pending_goal_ = gh;
+	has_pending_goal_ = true;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::processPendingGoal(
+    const ros::TimerEvent& /*event*/) {
+	GoalHandle gh;
+	{
+		std::lock_guard<std::mutex> lock(pending_goal_mutex_);
+		if (!has_pending_goal_) return;
+		gh = pending_goal_;
+		has_pending_goal_ = false;
+	}
+	processGoal(gh);
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::processGoal(
+    GoalHandle gh) {
 	// Precondition: Running controller
 	if (!this->isRunning()) {
 		ROS_ERROR_NAMED(name_, "Can't accept new action goals. Controller is not running.");
 		control_msgs::FollowJointTrajectoryResult result;
-		result.error_code =
-		    control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;  // TODO: Add better error status to msg?
+		result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;
+		result.error_string = "Controller is not running";
 		gh.setRejected(result);
 		return;
 	}
 
+	stopStreaming();
+
 	// If partial joints goals are not allowed, goal should specify all controller joints
 	if (!allow_partial_joints_goal_) {
 		if (gh.getGoal()->trajectory.joint_names.size() != joint_names_.size()) {
 			ROS_ERROR_NAMED(name_, "Joints on incoming goal don't match the controller joints.");
 			control_msgs::FollowJointTrajectoryResult result;
 			result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_JOINTS;
+			result.error_string = "Goal has to specify all controller joints";
 			gh.setRejected(result);
 			return;
 		}
@@ -90,28 +453,67 @@ inline void KD45TrajectoryController<TactileSensors>::goalCB(GoalHandle gh) {
 		ROS_ERROR_NAMED(name_, "Joints on incoming goal don't match the controller joints.");
 		control_msgs::FollowJointTrajectoryResult result;
 		result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_JOINTS;
+		result.error_string = "Goal joints don't match the controller joints";
 		gh.setRejected(result);
 		return;
 	}
 
+	// In append mode, goals without explicit start time are queued behind the active one instead of replacing it
+	JointTrajectoryConstPtr trajectory =
+	    joint_trajectory_controller::internal::share_member(gh.getGoal(), gh.getGoal()->trajectory);
+	const bool append = goal_queue_enabled_ && hasUnfinishedGoal() && appendToCurrentTrajectory(trajectory);
+	const bool verify_grasp = grasp_verifier_.enabled() && closesGripper(*trajectory, mapping_vector, append);
+	boost::shared_ptr<TrackedGoalHandle> rt_goal(new TrackedGoalHandle(gh));
+	rt_goal->verify_grasp = verify_grasp;
+	// Impedance parameters can be changed for each goal, they take effect once the goal becomes active
+	if (impedance_available_) loadImpedanceParameters(controller_nh_, rt_goal->impedance);
+
+	// The place in the queue is taken before the segments are installed, the goal can still be rejected until then
+	if (append) {
+		std::lock_guard<std::mutex> lock(goal_mutex_);
+		QueuedGoal queued = { rt_goal, goal_queue_generation_.load() };
+		if (!goal_queue_.push(queued)) {
+			ROS_ERROR_NAMED(name_, "Goal queue is full, rejecting goal.");
+			control_msgs::FollowJointTrajectoryResult result;
+			result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;
+			result.error_string = "Goal queue is full";
+			gh.setRejected(result);
+			return;
+		}
+	}
+
 	// Try to update new trajectory
-	RealtimeGoalHandlePtr rt_goal(new RealtimeGoalHandle(gh));
-	std::string error_string = "";  // todo upstream passed this one to updateTrajctoryCommand
-	const bool update_ok = updateTrajectoryCommand(
-	    joint_trajectory_controller::internal::share_member(gh.getGoal(), gh.getGoal()->trajectory), rt_goal);
+	std::string error_string;
+	const bool update_ok = updateTrajectoryCommand(trajectory, rt_goal, &error_string);
 	rt_goal->preallocated_feedback_->joint_names = joint_names_;
 
 	if (update_ok) {
-		// Accept new goal
-		preemptActiveGoal();
+		if (append) {
+			// The realtime loop activates the goal once its first segment is reached, the timer keeps it alive until then
+			gh.setAccepted();
+			std::lock_guard<std::mutex> lock(goal_mutex_);
+			pruneQueuedGoalTimers();
+			queued_goal_timers_.push_back(std::make_pair(
+			    rt_goal, controller_nh_.createTimer(action_monitor_period_, &TrackedGoalHandle::runNonRealtime, rt_goal)));
+			return;
+		}
+
+		// Accept new goal, goals queued behind the active one are dropped as well
 		gh.setAccepted();
-		rt_active_goal_ = rt_goal;
+		preemptGoal(rt_goal);
 
 		// Setup goal status checking timer
 		goal_handle_timer_ =
-		    controller_nh_.createTimer(action_monitor_period_, &RealtimeGoalHandle::runNonRealtime, rt_goal);
+		    controller_nh_.createTimer(action_monitor_period_, &TrackedGoalHandle::runNonRealtime, rt_goal);
 		goal_handle_timer_.start();
 	} else {
+		if (append) {
+			// The realtime loop skips the queued goal, it is kept alive here until the loop has let go of it
+			rt_goal->finished = true;
+			std::lock_guard<std::mutex> lock(goal_mutex_);
+			queued_goal_timers_.push_back(std::make_pair(rt_goal, ros::Timer()));
+		}
+
 		// Reject invalid goal
 		control_msgs::FollowJointTrajectoryResult result;
 		result.error_code = control_msgs::FollowJointTrajectoryResult::INVALID_GOAL;
@@ -120,22 +522,38 @@ inline void KD45TrajectoryController<TactileSensors>::goalCB(GoalHandle gh) {
 	}
 }
 
-template <class TactileSensors>
-inline void KD45TrajectoryController<TactileSensors>::update(const ros::Time& time, const ros::Duration& period) {
-    ROS_DEBUG_STREAM_NAMED(name_ + ".forces", "Forces: [" << (*forces_)[0] << ", " << (*forces_)[1] << "]");
-
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::update(
+    const ros::Time& time, const ros::Duration& period) {
 	realtime_busy_ = true;
-	// Get currently followed trajectory
-	TrajectoryPtr curr_traj_ptr;
-	curr_trajectory_box_.get(curr_traj_ptr);
-	Trajectory& curr_traj = *curr_traj_ptr;
+	latency_budget_.startCycle();
+	const LatencyBudget::Clock::time_point cycle_start =
+	    state_shm_.isOpen() ? LatencyBudget::Clock::now() : LatencyBudget::Clock::time_point();
+
+	// Tactile forces since the last cycle, the previous ones are kept if the sensor is writing right now
+	rt_force_samples_ = forces_->take(rt_force_summary_);
+	rt_forces_ = rt_force_summary_.last;
+	ROS_DEBUG_STREAM_NAMED(name_ + ".forces", "Forces: [" << rt_forces_[0] << ", " << rt_forces_[1] << "]");
+
+	// Get currently followed trajectory, lock-free. Values read from the mailboxes stay valid for this cycle
+	epoch_domain_.enter();
+	const uint64_t trajectory_version = trajectory_mailbox_.version();
+	if (starting_trajectory_ && trajectory_version != starting_version_) starting_trajectory_ = nullptr;
+	Trajectory& curr_traj = starting_trajectory_ ? *starting_trajectory_ : *trajectory_mailbox_.read();
+	if (active_goal_.update()) {
+		// A goal can be aborted before it is installed, when its trajectory already conflicted with the force limit
+		if (active_goal_.get() && tracked(*active_goal_.get()).finished) active_goal_.set(nullptr);
+		resetGoalChecks();
+		if (active_goal_.get()) rt_impedance_ = tracked(*active_goal_.get()).impedance;
+	}
 
 	// Update time data
 	TimeData time_data;
 	time_data.time = time;  // Cache current time
 	time_data.period = period;  // Cache current control period
-	time_data.uptime = time_data_.readFromRT()->uptime + period;  // Update controller uptime
-	time_data_.writeFromNonRT(time_data);  // TODO: Grrr, we need a lock-free data structure here!
+	time_data.uptime = rt_uptime_ + period;  // Update controller uptime
+	rt_uptime_ = time_data.uptime;
+	published_time_data_.store(time_data);  // Lock-free, for the non-realtime threads
 
 	// NOTE: It is very important to execute the two above code blocks in the specified sequence: first get current
 	// trajectory, then update time data. Hopefully the following paragraph sheds a bit of light on the rationale.
@@ -146,19 +564,59 @@ inline void KD45TrajectoryController<TactileSensors>::update(const ros::Time& ti
 	// the
 	// next control cycle, leaving the current cycle without a valid trajectory.
 
+	// With delay compensation, commands are sampled from the trajectory at the time they take effect on the actuator.
+	// Segment timing and tolerance checks use that time as well, so that they stay consistent with the command.
+	const ros::Time sample_time = time_data.uptime + actuation_delay_;
+	const bool force_frozen = updateForceLimit(curr_traj, trajectory_version, sample_time);
+
+	// Idle while holding the desired state of the last full cycle, new trajectories, goals, setpoints and tactile
+	// events end the idle mode right away
+	idle_ = idle_monitor_.update(holding_ && trajectory_version == holding_version_ && !stream_active_ &&
+	                                 !stream_queue_.front() && !force_frozen && !active_goal_.get(),
+	                             rt_force_summary_.min.data(), rt_force_summary_.max.data(), contact_threshold_,
+	                             period.toSec());
+	if (idle_) {
+		updateHolding(time_data, cycle_start);
+		realtime_busy_ = false;
+		return;
+	}
+
 	// Update current state and state error
+	latency_budget_.startStage(LatencyBudget::SAMPLING);
+	updateStream(sample_time);
+	dropStaleQueuedGoals();
+	bool finished = true;
+	RealtimeGoalHandle* queued_goal_reached = nullptr;
 	for (unsigned int i = 0; i < joints_.size(); ++i) {
 		current_state_.position[i] = joints_[i].getPosition();
 		current_state_.velocity[i] = joints_[i].getVelocity();
 		// There's no acceleration data available in a joint handle
 
-		typename TrajectoryPerJoint::const_iterator segment_it =
-		    sample(curr_traj[i], time_data.uptime.toSec(), desired_joint_state_);
-		if (curr_traj[i].end() == segment_it) {
-			// Non-realtime safe, but should never happen under normal operation
-			ROS_ERROR_NAMED(
-			    name_, "Unexpected error: No trajectory defined at current time. Please contact the package maintainer.");
-			return;
+		// Measured state as expected at sample time
+		Scalar measured_position = current_state_.position[i];
+		const Scalar measured_velocity = current_state_.velocity[i];
+		if (delay_compensation_) {
+			velocity_observer_.update(i, measured_position, period.toSec());
+			measured_position = velocity_observer_.predict(i, measured_position, actuation_delay_.toSec());
+		}
+
+		// Streamed setpoints take precedence over the trajectory
+		typename TrajectoryPerJoint::const_iterator segment_it = curr_traj[i].end();
+		if (stream_active_ || stream_holding_) {
+			desired_joint_state_.position[0] = stream_state_.position[i];
+			desired_joint_state_.velocity[0] = stream_state_.velocity[i];
+			desired_joint_state_.acceleration[0] = stream_state_.acceleration[i];
+		} else {
+			segment_it = sample(curr_traj[i], sample_time.toSec(), desired_joint_state_);
+			if (curr_traj[i].end() == segment_it) {
+				// Non-realtime safe, but should never happen under normal operation
+				ROS_ERROR_NAMED(
+				    name_, "Unexpected error: No trajectory defined at current time. Please contact the package maintainer.");
+				return;
+			}
+			// The desired state stays constant after the last segment, if it ends at rest
+			finished = finished && segment_it == --curr_traj[i].end() && sample_time.toSec() >= segment_it->endTime() &&
+			           desired_joint_state_.velocity[0] == 0.0 && desired_joint_state_.acceleration[0] == 0.0;
 		}
 		desired_state_.position[i] = desired_joint_state_.position[0];
 		desired_state_.velocity[i] = desired_joint_state_.velocity[0];
@@ -166,20 +624,36 @@ inline void KD45TrajectoryController<TactileSensors>::update(const ros::Time& ti
 		;
 
 		state_joint_error_.position[0] =
-		    angles::shortest_angular_distance(current_state_.position[i], desired_joint_state_.position[0]);
-		state_joint_error_.velocity[0] = desired_joint_state_.velocity[0] - current_state_.velocity[i];
+		    angles::shortest_angular_distance(measured_position, desired_joint_state_.position[0]);
+		state_joint_error_.velocity[0] = desired_joint_state_.velocity[0] - measured_velocity;
 		state_joint_error_.acceleration[0] = 0.0;
 
-		state_error_.position[i] =
-		    angles::shortest_angular_distance(current_state_.position[i], desired_joint_state_.position[0]);
-		state_error_.velocity[i] = desired_joint_state_.velocity[0] - current_state_.velocity[i];
+		state_error_.position[i] = angles::shortest_angular_distance(measured_position, desired_joint_state_.position[0]);
+		state_error_.velocity[i] = desired_joint_state_.velocity[0] - measured_velocity;
 		state_error_.acceleration[i] = 0.0;
 
+		// Streamed setpoints don't belong to a goal, there are no tolerances to check
+		if (stream_active_ || stream_holding_) continue;
+
 		// Check tolerances
-		const RealtimeGoalHandlePtr rt_segment_goal = segment_it->getGoalHandle();
-		if (rt_segment_goal && rt_segment_goal == rt_active_goal_) {
+		RealtimeGoalHandle* rt_segment_goal = segment_it->getGoalHandle().get();
+		RealtimeGoalHandle* active_goal = active_goal_.get();
+		const QueuedGoal* next_goal = goal_queue_.front();
+		if (rt_segment_goal && rt_segment_goal != active_goal && next_goal && next_goal->goal.get() == rt_segment_goal) {
+			// A queued goal is reached, it takes over once the active goal has ended inside its goal tolerances
+			queued_goal_reached = rt_segment_goal;
+			const Segment* last_segment = segment_it != curr_traj[i].begin() ? &*std::prev(segment_it) : nullptr;
+			if (active_goal && last_segment && last_segment->getGoalHandle().get() == active_goal) {
+				last_segment->sample(last_segment->endTime(), goal_end_state_);
+				goal_end_error_.position[0] =
+				    angles::shortest_angular_distance(measured_position, goal_end_state_.position[0]);
+				goal_end_error_.velocity[0] = goal_end_state_.velocity[0] - measured_velocity;
+				goal_end_error_.acceleration[0] = 0.0;
+				checkGoalTolerances(*active_goal, i, *last_segment, goal_end_error_, sample_time);
+			}
+		} else if (rt_segment_goal && rt_segment_goal == active_goal) {
 			// Check tolerances
-			if (time_data.uptime.toSec() < segment_it->endTime()) {
+			if (sample_time.toSec() < segment_it->endTime()) {
 				// Currently executing a segment: check path tolerances
 				const joint_trajectory_controller::SegmentTolerancesPerJoint<Scalar>& joint_tolerances =
 				    segment_it->getTolerances();
@@ -190,82 +664,667 @@ inline void KD45TrajectoryController<TactileSensors>::update(const ros::Time& ti
 					}
 
 					if (rt_segment_goal && rt_segment_goal->preallocated_result_) {
-						rt_segment_goal->preallocated_result_->error_code =
-						    control_msgs::FollowJointTrajectoryResult::PATH_TOLERANCE_VIOLATED;
-						rt_segment_goal->setAborted(rt_segment_goal->preallocated_result_);
-						rt_active_goal_.reset();
-						successful_joint_traj_.reset();
+						describeToleranceViolation(tracked(*rt_segment_goal).error, "Path", joint_names_[i],
+						                           state_joint_error_, joint_tolerances.state_tolerance);
+						abortGoal(*rt_segment_goal, control_msgs::FollowJointTrajectoryResult::PATH_TOLERANCE_VIOLATED);
 					} else {
 						ROS_ERROR_STREAM("rt_segment_goal->preallocated_result_ NULL Pointer");
 					}
 				}
 			} else if (segment_it == --curr_traj[i].end()) {
-				if (verbose_)
-					ROS_DEBUG_STREAM_THROTTLE_NAMED(1, name_, "Finished executing last segment, checking goal tolerances");
-
-				// Controller uptimegit st
-				const ros::Time uptime = time_data_.readFromRT()->uptime;
-
-				// Checks that we have ended inside the goal tolerances
-				const joint_trajectory_controller::SegmentTolerancesPerJoint<Scalar>& tolerances = segment_it->getTolerances();
-				const bool inside_goal_tolerances =
-				    checkStateTolerancePerJoint(state_joint_error_, tolerances.goal_state_tolerance);
-
-				if (inside_goal_tolerances) {
-					successful_joint_traj_[i] = 1;
-				} else if (uptime.toSec() < segment_it->endTime() + tolerances.goal_time_tolerance) {
-					// Still have some time left to meet the goal state tolerances
-				} else {
-					if (verbose_) {
-						ROS_ERROR_STREAM_NAMED(name_, "Goal tolerances failed for joint: " << joint_names_[i]);
-						// Check the tolerances one more time to output the errors that occurs
-						checkStateTolerancePerJoint(state_joint_error_, tolerances.goal_state_tolerance, true);
-					}
-
-					if (rt_segment_goal) {
-						rt_segment_goal->preallocated_result_->error_code =
-						    control_msgs::FollowJointTrajectoryResult::GOAL_TOLERANCE_VIOLATED;
-						rt_segment_goal->setAborted(rt_segment_goal->preallocated_result_);
-					} else {
-						ROS_ERROR_STREAM("rt_segment_goal->preallocated_result_ NULL Pointer");
-					}
-					rt_active_goal_.reset();
-					successful_joint_traj_.reset();
-				}
+				checkGoalTolerances(*rt_segment_goal, i, *segment_it, state_joint_error_, sample_time);
 			}
 		}
 	}
 
-	// If there is an active goal and all segments finished successfully then set goal as succeeded
-	RealtimeGoalHandlePtr current_active_goal(rt_active_goal_);
+	// The command may have been frozen by an aborted goal sequence in this cycle
+	if (force_frozen_) holdFrozenPosition();
+	publishJointState();
+	holding_ = finished && !stream_active_;
+	holding_version_ = trajectory_version;
+
+	// Fault detection on the state of this cycle
+	if (fault_detector_.enabled() && joints_.size() == kNumFingers) {
+		const uint32_t faults = fault_detector_.update(state_error_.position.data(), current_state_.velocity.data(),
+		                                               rt_forces_.data(), contact_threshold_, period.toSec());
+		RealtimeGoalHandle* faulted_goal = active_goal_.get();
+		if (faults && fault_detector_.abortGoal() && faulted_goal && faulted_goal->preallocated_result_) {
+			typedef FaultDetector<Scalar, kNumFingers> Faults;
+			tracked(*faulted_goal).error.format("Gripper fault: %s", Faults::describe(Faults::first(faults)));
+			abortGoal(*faulted_goal, control_msgs::FollowJointTrajectoryResult::PATH_TOLERANCE_VIOLATED);
+		}
+	}
+
+	// If there is an active goal and all segments finished successfully then set goal as succeeded, after the grasp
+	// has been verified for goals closing the gripper
+	RealtimeGoalHandle* current_active_goal = active_goal_.get();
+	bool verified = true;
 	if (current_active_goal && current_active_goal->preallocated_result_ &&
+	    successful_joint_traj_.count() == joints_.size() && tracked(*current_active_goal).verify_grasp) {
+		// the mean over all samples of the cycle, a single sample would alias sensor noise into the window
+		typename GraspVerifier<kNumFingers>::Result verification =
+		    grasp_verifier_.update(rt_force_summary_.mean.data(), period.toSec());
+		// The fingers follow a queued goal from this cycle on, the grasp is judged by the forces seen until now
+		if (verification == GraspVerifier<kNumFingers>::PENDING && queued_goal_reached) {
+			verification = grasp_verifier_.finish();
+		}
+		switch (verification) {
+			case GraspVerifier<kNumFingers>::PENDING:
+				verified = false;
+				break;
+			case GraspVerifier<kNumFingers>::FAILED:
+				grasp_verifier_.describe(tracked(*current_active_goal).error);
+				abortGoal(*current_active_goal, control_msgs::FollowJointTrajectoryResult::GOAL_TOLERANCE_VIOLATED);
+				verified = false;
+				break;
+			case GraspVerifier<kNumFingers>::VERIFIED:
+				break;
+		}
+	}
+	if (verified && current_active_goal && current_active_goal->preallocated_result_ &&
 	    successful_joint_traj_.count() == joints_.size()) {
 		current_active_goal->preallocated_result_->error_code = control_msgs::FollowJointTrajectoryResult::SUCCESSFUL;
 		current_active_goal->setSucceeded(current_active_goal->preallocated_result_);
-		rt_active_goal_.reset();
-		successful_joint_traj_.reset();
+		tracked(*current_active_goal).finished = true;
+		active_goal_.set(nullptr);
+		resetGoalChecks();
 	}
 
+	// The queued goal takes over from a goal that has succeeded, or when there was none
+	if (queued_goal_reached && !active_goal_.get()) activateQueuedGoal(queued_goal_reached);
+	latency_budget_.endStage(LatencyBudget::SAMPLING);
+
 	// Hardware interface adapter: Generate and send commands
-	hw_iface_adapter_.updateCommand(time_data.uptime, time_data.period, desired_state_, state_error_);
+	latency_budget_.startStage(LatencyBudget::COMMAND);
+	writeCommand(time_data);
+	latency_budget_.endStage(LatencyBudget::COMMAND);
+
+	if (state_shm_.isOpen()) writeStateSnapshot(time_data.uptime, cycle_start);
+
+	// Feedback and state publishing are not critical, drop them if this cycle is already late
+	if (latency_budget_.skipNonCritical()) {
+		ROS_DEBUG_STREAM_THROTTLE_NAMED(1, name_, "Cycle over latency budget, skipping feedback and state publishing");
+		realtime_busy_ = false;
+		return;
+	}
 
 	// Set action feedback
-	if (rt_active_goal_ && rt_active_goal_->preallocated_feedback_) {
-		rt_active_goal_->preallocated_feedback_->header.stamp = time_data_.readFromRT()->time;
-		rt_active_goal_->preallocated_feedback_->desired.positions = desired_state_.position;
-		rt_active_goal_->preallocated_feedback_->desired.velocities = desired_state_.velocity;
-		rt_active_goal_->preallocated_feedback_->desired.accelerations = desired_state_.acceleration;
-		rt_active_goal_->preallocated_feedback_->actual.positions = current_state_.position;
-		rt_active_goal_->preallocated_feedback_->actual.velocities = current_state_.velocity;
-		rt_active_goal_->preallocated_feedback_->error.positions = state_error_.position;
-		rt_active_goal_->preallocated_feedback_->error.velocities = state_error_.velocity;
-		rt_active_goal_->setFeedback(rt_active_goal_->preallocated_feedback_);
+	latency_budget_.startStage(LatencyBudget::FEEDBACK);
+	RealtimeGoalHandle* feedback_goal = active_goal_.get();
+	if (feedback_goal && feedback_goal->preallocated_feedback_) {
+		feedback_goal->preallocated_feedback_->header.stamp = time_data.time;
+		feedback_goal->preallocated_feedback_->desired.positions = desired_state_.position;
+		feedback_goal->preallocated_feedback_->desired.velocities = desired_state_.velocity;
+		feedback_goal->preallocated_feedback_->desired.accelerations = desired_state_.acceleration;
+		feedback_goal->preallocated_feedback_->actual.positions = current_state_.position;
+		feedback_goal->preallocated_feedback_->actual.velocities = current_state_.velocity;
+		feedback_goal->preallocated_feedback_->error.positions = state_error_.position;
+		feedback_goal->preallocated_feedback_->error.velocities = state_error_.velocity;
+		feedback_goal->setFeedback(feedback_goal->preallocated_feedback_);
 	}
+	latency_budget_.endStage(LatencyBudget::FEEDBACK);
 
 	// Publish state
-	publishState(time_data.uptime);
+	if (!latency_budget_.skipNonCritical()) {
+		latency_budget_.startStage(LatencyBudget::PUBLISH);
+		publishState(time_data.uptime);
+		latency_budget_.endStage(LatencyBudget::PUBLISH);
+	}
 	realtime_busy_ = false;
 }
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::cancelCB(
+    GoalHandle gh) {
+	// A coalesced goal waiting to be processed is dropped, nothing else changes
+	{
+		std::lock_guard<std::mutex> lock(pending_goal_mutex_);
+		if (has_pending_goal_ && pending_goal_ == gh) {
+			has_pending_goal_ = false;
+			control_msgs::FollowJointTrajectoryResult result;
+			result.error_string = "Canceled before it was processed";
+			pending_goal_.setCanceled(result);
+			return;
+		}
+	}
+
+	// Canceling any goal of a queued sequence stops the gripper and cancels the whole sequence
+	bool owned = false;
+	{
+		std::lock_guard<std::mutex> lock(goal_mutex_);
+		const RealtimeGoalHandlePtr installed = active_goal_.installed();
+		owned = unfinished(installed) && installed->gh_ == gh;
+		for (const auto& goal_timer : queued_goal_timers_) {
+			owned = owned || (unfinished(goal_timer.first) && goal_timer.first->gh_ == gh);
+		}
+	}
+	if (!owned) return;
+
+	// Same as the base class, but without modifying the hold trajectory the realtime loop may follow
+	ROS_DEBUG_NAMED(name_, "Canceling active action goal because cancel callback recieved from actionlib.");
+	preemptGoal();
+	holdPosition();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::preemptGoal(
+    const RealtimeGoalHandlePtr& next) {
+	std::vector<RealtimeGoalHandlePtr> preempted;
+	{
+		std::lock_guard<std::mutex> lock(goal_mutex_);
+		goal_queue_generation_++;
+		const RealtimeGoalHandlePtr previous = active_goal_.installed();
+		active_goal_.install(next);
+
+		// The realtime loop may have moved on to a queued goal, all goals of the sequence are canceled
+		if (unfinished(previous)) preempted.push_back(previous);
+		for (const auto& goal_timer : queued_goal_timers_) {
+			if (unfinished(goal_timer.first)) preempted.push_back(goal_timer.first);
+		}
+		pruneQueuedGoalTimers();
+	}
+
+	// Outside of goal_mutex_, actionlib holds its own lock while calling cancelCB()
+	for (const RealtimeGoalHandlePtr& goal : preempted) goal->gh_.setCanceled();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::hasUnfinishedGoal() {
+	std::lock_guard<std::mutex> lock(goal_mutex_);
+	if (unfinished(active_goal_.installed())) return true;
+	for (const auto& goal_timer : queued_goal_timers_) {
+		if (unfinished(goal_timer.first)) return true;
+	}
+	return false;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::closesGripper(
+    const trajectory_msgs::JointTrajectory& msg, const std::vector<unsigned int>& mapping, bool append) {
+	if (joints_.size() != kNumFingers || msg.points.empty() || msg.points.back().positions.size() != mapping.size()) {
+		return false;
+	}
+
+	// An appended goal starts where the current trajectory ends
+	std::array<double, kNumFingers> start, goal;
+	TrajectoryPtr curr_traj_ptr;
+	if (append) curr_trajectory_box_.get(curr_traj_ptr);
+	const JointStateSample joint_state = loadPublished(published_joint_state_);
+	typename Segment::State end_state(1);
+	for (unsigned int i = 0; i < kNumFingers; ++i) {
+		if (curr_traj_ptr && !(*curr_traj_ptr)[i].empty()) {
+			const Segment& last_segment = (*curr_traj_ptr)[i].back();
+			last_segment.sample(last_segment.endTime(), end_state);
+			start[i] = end_state.position[0];
+		} else {
+			start[i] = joint_state.position[i];
+		}
+	}
+
+	// Joints the goal leaves out stay where they are
+	goal = start;
+	for (unsigned int j = 0; j < mapping.size(); ++j) goal[mapping[j]] = msg.points.back().positions[j];
+	return grasp_verifier_.closes(start.data(), goal.data());
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::resetGoalChecks() {
+	successful_joint_traj_.reset();
+	grasp_verifier_.reset();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::pruneQueuedGoalTimers() {
+	typedef actionlib_msgs::GoalStatus GoalStatus;
+
+	auto pending = [](const std::pair<RealtimeGoalHandlePtr, ros::Timer>& goal_timer) {
+		const uint8_t status = goal_timer.first->gh_.getGoalStatus().status;
+		// A goal rejected after it was queued is kept until the realtime loop has taken it out of the queue
+		return status == GoalStatus::PENDING || status == GoalStatus::ACTIVE || status == GoalStatus::PREEMPTING ||
+		       status == GoalStatus::RECALLING || (status == GoalStatus::REJECTED && goal_timer.first.use_count() > 1);
+	};
+	const auto first_done = std::partition(queued_goal_timers_.begin(), queued_goal_timers_.end(), pending);
+
+	// The realtime loop may still hold a goal it activated, until it has adopted the goal installed after it
+	for (auto it = first_done; it != queued_goal_timers_.end(); ++it) {
+		const RealtimeGoalHandlePtr goal = it->first;
+		epoch_domain_.retire([goal] {});
+	}
+	queued_goal_timers_.erase(first_done, queued_goal_timers_.end());
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::appendToCurrentTrajectory(
+    JointTrajectoryConstPtr& msg) {
+	// Goals with an explicit start time keep their timing
+	if (!msg->header.stamp.isZero()) return false;
+
+	TrajectoryPtr curr_traj_ptr;
+	curr_trajectory_box_.get(curr_traj_ptr);
+	if (!curr_traj_ptr || curr_traj_ptr->empty()) return false;
+
+	double end_time = 0.0;
+	bool verify_grasp = false;
+	for (const TrajectoryPerJoint& joint_traj : *curr_traj_ptr) {
+		if (joint_traj.empty()) continue;
+		end_time = std::max(end_time, static_cast<double>(joint_traj.back().endTime()));
+		const RealtimeGoalHandlePtr& last_goal = joint_traj.back().getGoalHandle();
+		verify_grasp = verify_grasp || (last_goal && tracked(*last_goal).verify_grasp);
+	}
+
+	// Nothing left to append to
+	const TimeData time_data = loadTimeData();
+	if (end_time <= time_data.uptime.toSec()) return false;
+
+	// The goal ahead holds its grasp for the verification window before the fingers move on
+	if (verify_grasp) end_time += grasp_verifier_.window();
+
+	// Start the goal when the current trajectory ends, in the time base of the message
+	trajectory_msgs::JointTrajectory::Ptr appended(new trajectory_msgs::JointTrajectory(*msg));
+	appended->header.stamp = time_data.time + ros::Duration(end_time - time_data.uptime.toSec());
+	msg = appended;
+	return true;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::checkGoalTolerances(
+    RealtimeGoalHandle& goal, unsigned int joint, const Segment& last_segment, const typename Segment::State& error,
+    const ros::Time& sample_time) {
+	if (verbose_) ROS_DEBUG_STREAM_THROTTLE_NAMED(1, name_, "Finished executing last segment, checking goal tolerances");
+
+	// Checks that we have ended inside the goal tolerances, sample_time is the controller uptime shifted by the
+	// actuation delay
+	const joint_trajectory_controller::SegmentTolerancesPerJoint<Scalar>& tolerances = last_segment.getTolerances();
+	const bool inside_goal_tolerances = checkStateTolerancePerJoint(error, tolerances.goal_state_tolerance);
+
+	if (inside_goal_tolerances) {
+		successful_joint_traj_[joint] = 1;
+	} else if (sample_time.toSec() < last_segment.endTime() + tolerances.goal_time_tolerance) {
+		// Still have some time left to meet the goal state tolerances
+	} else if (goal.preallocated_result_) {
+		if (verbose_) {
+			ROS_ERROR_STREAM_NAMED(name_, "Goal tolerances failed for joint: " << joint_names_[joint]);
+			// Check the tolerances one more time to output the errors that occurs
+			checkStateTolerancePerJoint(error, tolerances.goal_state_tolerance, true);
+		}
+
+		ErrorString& description = tracked(goal).error;
+		describeToleranceViolation(description, "Goal", joint_names_[joint], error, tolerances.goal_state_tolerance);
+		description.append(" after a goal time tolerance of %gs", static_cast<double>(tolerances.goal_time_tolerance));
+		abortGoal(goal, control_msgs::FollowJointTrajectoryResult::GOAL_TOLERANCE_VIOLATED);
+	}
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::activateQueuedGoal(
+    RealtimeGoalHandle* rt_segment_goal) {
+	QueuedGoal* next = goal_queue_.front();
+	if (!next || next->goal.get() != rt_segment_goal) return;
+
+	// The previous goal has succeeded already, the same checks apply to it as without a queue
+	active_goal_.set(rt_segment_goal);
+	resetGoalChecks();
+	rt_impedance_ = tracked(*rt_segment_goal).impedance;
+	QueuedGoal activated;
+	goal_queue_.pop(activated);
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::dropStaleQueuedGoals() {
+	// Goals queued before a replacement or cancel are canceled, goals rejected after queueing are skipped
+	const unsigned int generation = goal_queue_generation_.load();
+	QueuedGoal* next = goal_queue_.front();
+	while (next && (next->generation != generation || tracked(*next->goal).finished)) {
+		QueuedGoal stale;
+		goal_queue_.pop(stale);
+		if (!tracked(*stale.goal).finished) {
+			stale.goal->setCanceled(stale.goal->preallocated_result_);
+			tracked(*stale.goal).finished = true;
+		}
+		next = goal_queue_.front();
+	}
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::abortQueuedGoals(
+    int32_t error_code, const ErrorString& reason) {
+	bool aborted = false;
+	QueuedGoal queued;
+	while (goal_queue_.pop(queued)) {
+		aborted = true;
+		if (!queued.goal->preallocated_result_) continue;
+		queued.goal->preallocated_result_->error_code = error_code;
+		tracked(*queued.goal).error.format("Goal ahead in the queue failed: %s", reason.c_str());
+		tracked(*queued.goal).requestAbort();
+		tracked(*queued.goal).finished = true;
+	}
+	return aborted;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::abortGoal(
+    RealtimeGoalHandle& goal, int32_t error_code) {
+	TrackedGoalHandle& tracked_goal = tracked(goal);
+	goal.preallocated_result_->error_code = error_code;
+	tracked_goal.requestAbort();
+	tracked_goal.finished = true;
+	active_goal_.set(nullptr);
+	resetGoalChecks();
+
+	// The segments of the aborted queued goals are still in the trajectory. The command is frozen right away, the
+	// monitor timer replaces the trajectory by a hold trajectory
+	if (abortQueuedGoals(error_code, tracked_goal.error)) {
+		freezePosition();
+		hold_request_ = force_frozen_version_ + 1;
+	}
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::trajectoryCommandCB(
+    const JointTrajectoryConstPtr& msg) {
+	stopStreaming();
+
+	// Same as the base class, which only preempts its own active goal
+	const bool update_ok = updateTrajectoryCommand(msg, RealtimeGoalHandlePtr());
+	if (update_ok) preemptGoal();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::streamCommandCB(
+    const trajectory_msgs::JointTrajectoryPointConstPtr& msg) {
+	if (!this->isRunning()) {
+		ROS_ERROR_THROTTLE_NAMED(1, name_, "Can't accept streamed setpoints. Controller is not running.");
+		return;
+	}
+	if (msg->positions.size() != joints_.size() ||
+	    (!msg->velocities.empty() && msg->velocities.size() != joints_.size())) {
+		ROS_ERROR_THROTTLE_NAMED(1, name_, "Streamed setpoint size doesn't match the controller joints.");
+		return;
+	}
+
+	StreamSetpoint setpoint;
+	for (unsigned int i = 0; i < kNumFingers; ++i) {
+		setpoint.position[i] = msg->positions[i];
+		setpoint.velocity[i] = msg->velocities.empty() ? 0.0 : msg->velocities[i];
+		if (!std::isfinite(setpoint.position[i]) || !std::isfinite(setpoint.velocity[i])) {
+			ROS_ERROR_THROTTLE_NAMED(1, name_, "Streamed setpoint is not finite, ignoring it.");
+			return;
+		}
+	}
+
+	// The blend segment can not end before it starts, a negative time_from_start blends right away
+	const double blend_time = msg->time_from_start.isZero() ? stream_blend_time_ : msg->time_from_start.toSec();
+	setpoint.blend_time = std::min(std::max(blend_time, 0.0), stream_max_blend_time_);
+
+	// Streaming takes over from the active goal and the goals queued behind it
+	if (!streaming_.exchange(true)) preemptGoal();
+	setpoint.generation = stream_generation_.load();
+
+	if (!stream_queue_.push(setpoint)) {
+		ROS_WARN_THROTTLE_NAMED(1, name_, "Stream queue full, dropping setpoint.");
+	}
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::stopStreaming() {
+	// Setpoints still queued from before are ignored by the realtime loop
+	stream_generation_++;
+	if (streaming_.exchange(false)) holdPosition();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::updateStream(
+    const ros::Time& sample_time) {
+	// Only the latest setpoint of the current generation is relevant
+	const unsigned int generation = stream_generation_.load();
+	StreamSetpoint setpoint, next;
+	bool received = false;
+	while (stream_queue_.pop(next)) {
+		if (next.generation != generation) continue;
+		setpoint = next;
+		received = true;
+	}
+
+	if (received) {
+		// Blend from the last desired state, so the command stays continuous
+		for (unsigned int i = 0; i < kNumFingers; ++i) {
+			stream_start_state_.position[i] = desired_state_.position[i];
+			stream_start_state_.velocity[i] = desired_state_.velocity[i];
+			stream_end_state_.position[i] = setpoint.position[i];
+			stream_end_state_.velocity[i] = setpoint.velocity[i];
+		}
+		const Scalar start_time = sample_time.toSec();
+		stream_segment_.init(start_time, stream_start_state_, start_time + setpoint.blend_time, stream_end_state_);
+		stream_trajectory_version_ = trajectory_mailbox_.version();
+		stream_active_generation_ = generation;
+		stream_active_ = true;
+		stream_holding_ = false;
+	} else if ((stream_active_ || stream_holding_) && (trajectory_mailbox_.version() != stream_trajectory_version_ ||
+	                                                   generation != stream_active_generation_)) {
+		// A new trajectory was installed
+		stream_active_ = false;
+		stream_holding_ = false;
+	}
+	if (!stream_active_) return;
+
+	stream_segment_.sample(sample_time.toSec(), stream_state_);
+	if (sample_time.toSec() < stream_segment_.endTime()) return;
+
+	// The blend has ended without a new setpoint, the stream is done until the next one. Its position is held at rest,
+	// so that the controller can go idle like at the end of a trajectory
+	for (unsigned int i = 0; i < kNumFingers; ++i) {
+		stream_state_.velocity[i] = 0.0;
+		stream_state_.acceleration[i] = 0.0;
+	}
+	stream_active_ = false;
+	stream_holding_ = true;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::updateForceLimit(
+    const Trajectory& curr_traj, uint64_t trajectory_version, const ros::Time& sample_time) {
+	if (force_limit_->consumeTrip()) {
+		freezePosition();
+
+		RealtimeGoalHandle* limited_goal = active_goal_.get();
+		if (limited_goal && limited_goal->preallocated_result_) {
+			typename ForceLimit<kNumFingers>::Event event;
+			ErrorString& error = tracked(*limited_goal).error;
+			if (force_limit_->lastEvent(event)) {
+				error.format("Force limit of %g exceeded by finger %u, sample [", force_limit_->maxForce(),
+				             event.finger);
+				for (unsigned int i = 0; i < kNumFingers; ++i) error.append(i ? ", %.3f" : "%.3f", event.force[i]);
+				error.append("] at %.6fs", event.stamp);
+			} else {
+				error.format("Force limit of %g exceeded", force_limit_->maxForce());
+			}
+			abortGoal(*limited_goal, control_msgs::FollowJointTrajectoryResult::PATH_TOLERANCE_VIOLATED);
+		}
+
+		// The trajectory goes on closing behind the frozen command. It is replaced by a hold trajectory, so that the
+		// next command starts from the frozen position
+		hold_request_ = force_frozen_version_ + 1;
+		return true;
+	}
+
+	// A new trajectory releases the freeze. While the forces are still above the limit, only trajectories opening the
+	// gripper are followed, also after the hold trajectory took over. The command is frozen for any other at the
+	// position of the trip and its goal is aborted
+	if (trajectory_version == force_frozen_version_ || !(force_frozen_ || force_limit_->above())) return force_frozen_;
+	force_frozen_version_ = trajectory_version;
+	RealtimeGoalHandle* closing_goal = nullptr;
+	force_frozen_ = force_limit_->above() && closesFrozenGripper(curr_traj, sample_time, closing_goal);
+	if (force_frozen_ && closing_goal && closing_goal->preallocated_result_ && !tracked(*closing_goal).finished) {
+		tracked(*closing_goal)
+		    .error.format("Force limit of %g still exceeded, only opening the gripper is allowed",
+		                  force_limit_->maxForce());
+		abortGoal(*closing_goal, control_msgs::FollowJointTrajectoryResult::PATH_TOLERANCE_VIOLATED);
+	}
+	return force_frozen_;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline bool KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::closesFrozenGripper(
+    const Trajectory& trajectory, const ros::Time& sample_time, RealtimeGoalHandle*& goal) {
+	// Per finger, the force on a pad rises as soon as its finger closes further than where it is held or actually is,
+	// e.g. a hold trajectory at the actual position does not close
+	const double closing_direction = grasp_verifier_.closingDirection();
+	for (unsigned int i = 0; i < joints_.size() && i < trajectory.size(); ++i) {
+		const double closed = std::max(closing_direction * force_frozen_position_[i],
+		                               closing_direction * joints_[i].getPosition());
+		for (const Segment& segment : trajectory[i]) {
+			if (segment.endTime() < sample_time.toSec()) continue;
+			// Both ends, a trajectory starting from a sample of the previous one may start closer than the frozen
+			// position
+			for (const double time : { std::max(segment.startTime(), sample_time.toSec()), segment.endTime() }) {
+				segment.sample(time, force_frozen_sample_);
+				if (closing_direction * force_frozen_sample_.position[0] > closed) {
+					goal = segment.getGoalHandle().get();
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::freezePosition() {
+	force_frozen_ = true;
+	force_frozen_version_ = trajectory_mailbox_.version();
+	for (unsigned int i = 0; i < joints_.size(); ++i) force_frozen_position_[i] = joints_[i].getPosition();
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::holdFrozenPosition() {
+	for (unsigned int i = 0; i < joints_.size(); ++i) {
+		desired_state_.position[i] = force_frozen_position_[i];
+		desired_state_.velocity[i] = 0.0;
+		desired_state_.acceleration[i] = 0.0;
+		state_error_.position[i] =
+		    angles::shortest_angular_distance(current_state_.position[i], force_frozen_position_[i]);
+		state_error_.velocity[i] = -current_state_.velocity[i];
+		state_error_.acceleration[i] = 0.0;
+	}
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::writeCommand(
+    const TimeData& time_data) {
+	if (impedance_available_ && rt_impedance_.enabled) {
+		updateImpedanceCommand(rt_impedance_);
+	} else {
+		hw_iface_adapter_.updateCommand(time_data.uptime, time_data.period, desired_state_, state_error_);
+	}
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::updateHolding(
+    const TimeData& time_data, const LatencyBudget::Clock::time_point& cycle_start) {
+	// The desired state is that of the last full cycle, only the errors to it change
+	for (unsigned int i = 0; i < joints_.size(); ++i) {
+		current_state_.position[i] = joints_[i].getPosition();
+		current_state_.velocity[i] = joints_[i].getVelocity();
+		// Keeps the observer continuous for the next full cycle
+		if (delay_compensation_) velocity_observer_.update(i, current_state_.position[i], time_data.period.toSec());
+
+		state_error_.position[i] = angles::shortest_angular_distance(current_state_.position[i], desired_state_.position[i]);
+		state_error_.velocity[i] = desired_state_.velocity[i] - current_state_.velocity[i];
+		state_error_.acceleration[i] = 0.0;
+	}
+	publishJointState();
+
+	// There is no goal to abort, faults are still detected and reported
+	if (fault_detector_.enabled() && joints_.size() == kNumFingers) {
+		fault_detector_.update(state_error_.position.data(), current_state_.velocity.data(), rt_forces_.data(),
+		                       contact_threshold_, time_data.period.toSec());
+	}
+
+	writeCommand(time_data);
+	if (state_shm_.isOpen()) writeStateSnapshot(time_data.uptime, cycle_start);
+	if (!latency_budget_.skipNonCritical()) publishState(time_data.uptime);
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::writeStateSnapshot(
+    const ros::Time& uptime, const LatencyBudget::Clock::time_point& cycle_start) {
+	snapshot_.cycle++;
+	snapshot_.uptime = uptime.toSec();
+	snapshot_.compute_time = std::chrono::duration<double>(LatencyBudget::Clock::now() - cycle_start).count();
+
+	snapshot_.num_joints = std::min<size_t>(joints_.size(), kSnapshotMaxJoints);
+	for (unsigned int i = 0; i < snapshot_.num_joints; ++i) {
+		snapshot_.position[i] = current_state_.position[i];
+		snapshot_.velocity[i] = current_state_.velocity[i];
+		snapshot_.desired_position[i] = desired_state_.position[i];
+		snapshot_.desired_velocity[i] = desired_state_.velocity[i];
+		snapshot_.position_error[i] = state_error_.position[i];
+		snapshot_.velocity_error[i] = state_error_.velocity[i];
+	}
+	for (unsigned int i = 0; i < kNumFingers; ++i) {
+		snapshot_.force[i] = rt_forces_[i];
+		snapshot_.force_min[i] = rt_force_summary_.min[i];
+		snapshot_.force_max[i] = rt_force_summary_.max[i];
+		snapshot_.contact[i] = rt_forces_[i] > contact_threshold_;
+	}
+	snapshot_.force_samples = rt_force_samples_;
+	snapshot_.faults = fault_detector_.active();
+	for (int i = 0; i < LatencyBudget::NUM_STAGES; ++i)
+		snapshot_.stage_overruns[i] = latency_budget_.stageOverruns(static_cast<LatencyBudget::Stage>(i));
+	snapshot_.cycle_overruns = latency_budget_.cycleOverruns();
+	snapshot_.skipped_cycles = latency_budget_.skippedCycles();
+	const MessageStats& tactile_stats = sensors_->stats();
+	snapshot_.tactile_received = tactile_stats.received();
+	snapshot_.tactile_lost = tactile_stats.lost();
+	snapshot_.tactile_gaps = tactile_stats.gaps();
+	snapshot_.tactile_reordered = tactile_stats.reordered();
+	snapshot_.tactile_duplicates = tactile_stats.duplicates();
+	snapshot_.tactile_restarts = tactile_stats.restarts();
+	snapshot_.tactile_mean_latency = tactile_stats.meanLatency();
+	snapshot_.tactile_max_latency = tactile_stats.maxLatency();
+
+	// All goal handles are created by processGoal()
+	const RealtimeGoalHandle* current_active_goal = active_goal_.get();
+	if (stream_active_) {
+		snapshot_.goal_state = StateSnapshot<kNumFingers>::STREAMING;
+		snapshot_.goal_id[0] = '\0';
+	} else if (current_active_goal) {
+		snapshot_.goal_state = StateSnapshot<kNumFingers>::GOAL_ACTIVE;
+		std::memcpy(snapshot_.goal_id, static_cast<const TrackedGoalHandle&>(*current_active_goal).goal_id, kGoalIdSize);
+	} else {
+		snapshot_.goal_state = idle_ ? StateSnapshot<kNumFingers>::IDLE : StateSnapshot<kNumFingers>::NO_GOAL;
+		snapshot_.goal_id[0] = '\0';
+	}
+
+	state_shm_.write(snapshot_);
+}
+
+template <class TactileSensors, class HardwareInterface, class SegmentImpl>
+inline void
+KD45TrajectoryController<TactileSensors, HardwareInterface, SegmentImpl>::updateImpedanceCommand(
+    const Impedance& impedance) {
+	typedef typename Impedance::Vector Vector;
+
+	const Vector position_error = Eigen::Map<const Vector>(state_error_.position.data());
+	const Vector velocity_error = Eigen::Map<const Vector>(state_error_.velocity.data());
+	const Vector force =
+	    Eigen::Map<const Eigen::Array<float, kNumFingers, 1, Eigen::DontAlign>>(rt_forces_.data()).template cast<Scalar>();
+
+	Vector effort;
+	computeImpedanceEffort(impedance, position_error, velocity_error, force, effort);
+
+	for (unsigned int i = 0; i < kNumFingers; ++i) joints_[i].setCommand(effort[i]);
+}
 }
 
 #endif  // KD45_CONTROLLER_KD45_CONTROLLER_IMPL_H
@@ -0,0 +1,103 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_LATENCY_BUDGET_H
+#define KD45_CONTROLLER_LATENCY_BUDGET_H
+
+#include <ros/ros.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+
+namespace kd45_controller {
+
+// keeps track of the time spent in the individual stages of one control cycle.
+// budgets are soft deadlines: overruns are counted and, if enabled, the remaining non-critical stages
+// (feedback, state publishing) of that cycle are skipped so that the command write stays on time.
+class LatencyBudget
+{
+public:
+	enum Stage { SAMPLING = 0, COMMAND, FEEDBACK, PUBLISH, NUM_STAGES };
+
+	typedef std::chrono::steady_clock Clock;
+
+	// reads the budgets (in seconds) from the "latency_budget" namespace. a budget <= 0 disables that check.
+	void init(ros::NodeHandle& nh);
+	// same without the parameter server, budgets in seconds
+	void configure(double cycle, const std::array<double, NUM_STAGES>& stages, bool skip_non_critical);
+
+	void startCycle();
+	void startStage(Stage stage);
+	void endStage(Stage stage);
+
+	// true if a non-critical stage should be skipped this cycle
+	bool skipNonCritical();
+	bool enabled() const { return enabled_; }
+
+	uint64_t stageOverruns(Stage stage) const { return stage_overruns_[stage].load(std::memory_order_relaxed); }
+	uint64_t cycleOverruns() const { return cycle_overruns_.load(std::memory_order_relaxed); }
+	uint64_t skippedCycles() const { return skipped_cycles_.load(std::memory_order_relaxed); }
+
+	static const char* stageName(Stage stage);
+
+protected:
+	bool enabled_ = false;
+	bool skip_non_critical_ = false;
+
+	Clock::duration cycle_budget_ = Clock::duration::zero();
+	std::array<Clock::duration, NUM_STAGES> stage_budgets_;
+
+	// per-cycle bookkeeping, only touched by the realtime thread
+	Clock::time_point cycle_start_;
+	std::array<Clock::time_point, NUM_STAGES> stage_start_;
+	bool over_budget_ = false;
+	bool cycle_counted_ = false;
+	bool skip_counted_ = false;
+
+	// read from non-rt threads
+	std::array<std::atomic<uint64_t>, NUM_STAGES> stage_overruns_;
+	std::atomic<uint64_t> cycle_overruns_{ 0 };
+	std::atomic<uint64_t> skipped_cycles_{ 0 };
+};
+}
+
+#include <latency_budget_impl.h>
+
+#endif  // KD45_CONTROLLER_LATENCY_BUDGET_H
@@ -0,0 +1,141 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_LATENCY_BUDGET_IMPL_H
+#define KD45_CONTROLLER_LATENCY_BUDGET_IMPL_H
+
+#include <latency_budget.h>
+
+namespace kd45_controller {
+namespace internal {
+inline std::chrono::steady_clock::duration toDuration(double seconds) {
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+}
+
+inline void LatencyBudget::init(ros::NodeHandle& nh) {
+	ros::NodeHandle budget_nh(nh, "latency_budget");
+
+	double cycle = 0.0;
+	bool skip_non_critical = false;
+	std::array<double, NUM_STAGES> stages;
+	budget_nh.param("cycle", cycle, 0.0);
+	budget_nh.param("skip_non_critical", skip_non_critical, false);
+	for (int i = 0; i < NUM_STAGES; i++) budget_nh.param(stageName(static_cast<Stage>(i)), stages[i], 0.0);
+	configure(cycle, stages, skip_non_critical);
+
+	if (enabled_) {
+		ROS_INFO_STREAM_NAMED("KD45C", "Latency budget enabled: cycle " << cycle << "s, skipping non-critical stages: "
+		                                                                << (skip_non_critical_ ? "yes" : "no"));
+	}
+}
+
+inline void LatencyBudget::configure(double cycle, const std::array<double, NUM_STAGES>& stages,
+                                     bool skip_non_critical) {
+	skip_non_critical_ = skip_non_critical;
+	cycle_budget_ = internal::toDuration(cycle);
+	enabled_ = cycle > 0.0;
+
+	for (int i = 0; i < NUM_STAGES; i++) {
+		stage_budgets_[i] = internal::toDuration(stages[i]);
+		stage_overruns_[i].store(0, std::memory_order_relaxed);
+		enabled_ = enabled_ || stages[i] > 0.0;
+	}
+	cycle_overruns_.store(0, std::memory_order_relaxed);
+	skipped_cycles_.store(0, std::memory_order_relaxed);
+}
+
+inline void LatencyBudget::startCycle() {
+	over_budget_ = false;
+	cycle_counted_ = false;
+	skip_counted_ = false;
+	if (!enabled_) return;
+
+	cycle_start_ = Clock::now();
+}
+
+inline void LatencyBudget::startStage(Stage stage) {
+	if (!enabled_) return;
+
+	stage_start_[stage] = Clock::now();
+}
+
+inline void LatencyBudget::endStage(Stage stage) {
+	if (!enabled_) return;
+
+	const Clock::time_point now = Clock::now();
+	if (stage_budgets_[stage] > Clock::duration::zero() && now - stage_start_[stage] > stage_budgets_[stage]) {
+		stage_overruns_[stage].fetch_add(1, std::memory_order_relaxed);
+		over_budget_ = true;
+	}
+
+	// the cycle budget is checked after every stage, but each cycle is counted at most once
+	if (cycle_budget_ > Clock::duration::zero() && !cycle_counted_ && now - cycle_start_ > cycle_budget_) {
+		cycle_overruns_.fetch_add(1, std::memory_order_relaxed);
+		over_budget_ = true;
+		cycle_counted_ = true;
+	}
+}
+
+inline bool LatencyBudget::skipNonCritical() {
+	if (!skip_non_critical_ || !over_budget_) return false;
+
+	if (!skip_counted_) {
+		skipped_cycles_.fetch_add(1, std::memory_order_relaxed);
+		skip_counted_ = true;
+	}
+	return true;
+}
+
+inline const char* LatencyBudget::stageName(Stage stage) {
+	switch (stage) {
+		case SAMPLING:
+			return "sampling";
+		case COMMAND:
+			return "command";
+		case FEEDBACK:
+			return "feedback";
+		case PUBLISH:
+			return "publish";
+		default:
+			return "unknown";
+	}
+}
+}
+
+#endif  // KD45_CONTROLLER_LATENCY_BUDGET_IMPL_H
@@ -0,0 +1,116 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_LINEAR_SEGMENT_H
+#define KD45_CONTROLLER_LINEAR_SEGMENT_H
+
+#include <trajectory_interface/pos_vel_acc_state.h>
+
+#include <stdexcept>
+#include <vector>
+
+namespace kd45_controller {
+
+// linear interpolation between two positions, drop-in replacement for trajectory_interface::QuinticSplineSegment.
+// velocities and accelerations of the boundary states are ignored. cheapest to sample, but the velocity is
+// discontinuous at segment boundaries.
+template <class ScalarType>
+class LinearSegment
+{
+public:
+	typedef ScalarType Scalar;
+	typedef Scalar Time;
+	typedef trajectory_interface::PosVelAccState<Scalar> State;
+
+	LinearSegment() : duration_(static_cast<Scalar>(0)), start_time_(static_cast<Scalar>(0)) {}
+
+	LinearSegment(const Time& start_time, const State& start_state, const Time& end_time, const State& end_state) {
+		init(start_time, start_state, end_time, end_state);
+	}
+
+	void init(const Time& start_time, const State& start_state, const Time& end_time, const State& end_state) {
+		if (end_time < start_time) {
+			throw(std::invalid_argument("Linear segment can't be constructed: end_time < start_time."));
+		}
+		if (start_state.position.empty() || end_state.position.empty()) {
+			throw(std::invalid_argument("Linear segment can't be constructed: Endpoint positions can't be empty."));
+		}
+		if (start_state.position.size() != end_state.position.size()) {
+			throw(std::invalid_argument("Linear segment can't be constructed: Endpoint positions size mismatch."));
+		}
+
+		start_time_ = start_time;
+		duration_ = end_time - start_time;
+
+		const unsigned int dim = start_state.position.size();
+		start_position_ = start_state.position;
+		slope_.resize(dim);
+		for (unsigned int i = 0; i < dim; ++i) {
+			slope_[i] = duration_ > 0.0 ? (end_state.position[i] - start_state.position[i]) / duration_ : 0.0;
+		}
+	}
+
+	void sample(const Time& time, State& state) const {
+		// Resize state data. Should be a no-op if appropriately sized
+		state.position.resize(size());
+		state.velocity.resize(size());
+		state.acceleration.resize(size());
+
+		// Outside of the segment the boundary position is held
+		const bool inside = time >= start_time_ && time <= start_time_ + duration_;
+		const Time t = time < start_time_ ? 0.0 : (inside ? time - start_time_ : duration_);
+		for (unsigned int i = 0; i < size(); ++i) {
+			state.position[i] = start_position_[i] + slope_[i] * t;
+			state.velocity[i] = inside ? slope_[i] : 0.0;
+			state.acceleration[i] = 0.0;
+		}
+	}
+
+	Time startTime() const { return start_time_; }
+	Time endTime() const { return start_time_ + duration_; }
+	unsigned int size() const { return start_position_.size(); }
+
+private:
+	std::vector<Scalar> start_position_;
+	std::vector<Scalar> slope_;
+	Time duration_;
+	Time start_time_;
+};
+}
+
+#endif  // KD45_CONTROLLER_LINEAR_SEGMENT_H
@@ -0,0 +1,85 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_MAILBOX_H
+#define KD45_CONTROLLER_MAILBOX_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <epoch_domain.h>
+
+namespace kd45_controller {
+
+// hands values from non-realtime threads to the realtime loop without locks on the realtime side.
+// writers publish a new value by exchanging an atomic pointer and retire the replaced one in the epoch domain, which
+// frees it once the realtime loop has entered a later epoch. the domain has to outlive the mailbox.
+template <class T>
+class Mailbox
+{
+public:
+	explicit Mailbox(EpochDomain& domain, const T& initial = T()) : domain_(domain), current_(new T(initial)) {}
+	~Mailbox() { delete current_.load(); }
+
+	Mailbox(const Mailbox&) = delete;
+	Mailbox& operator=(const Mailbox&) = delete;
+
+	// non-realtime, may be called from several threads
+	void publish(const T& value);
+
+	// number of values published so far
+	uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+	// realtime reader: the latest value, valid until the next EpochDomain::enter() or quiesce()
+	const T& read() const { return *current_.load(); }
+
+private:
+	EpochDomain& domain_;
+	std::atomic<T*> current_;
+	std::atomic<uint64_t> version_{ 0 };
+};
+
+template <class T>
+inline void Mailbox<T>::publish(const T& value) {
+	T* old = current_.exchange(new T(value));
+	version_.fetch_add(1, std::memory_order_release);
+	domain_.retire([old] { delete old; });
+}
+}
+
+#endif  // KD45_CONTROLLER_MAILBOX_H
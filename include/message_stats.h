@@ -0,0 +1,145 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_MESSAGE_STATS_H
+#define KD45_CONTROLLER_MESSAGE_STATS_H
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+
+namespace kd45_controller {
+
+// loss, reordering and latency of a message stream, from the header sequence numbers and stamps.
+// updated by the subscriber callback, the counters can be read from any thread.
+class MessageStats
+{
+public:
+	// a sequence number further back than this is taken as a restarted publisher, not as a late message
+	static constexpr int32_t kRestartThreshold = 1000;
+	// sequence numbers remembered as missing, covers everything a late message can refer to
+	static constexpr uint32_t kMissingWindow = 1024;
+	static_assert(kMissingWindow > kRestartThreshold, "late messages have to be within the missing window");
+
+	void update(uint32_t seq, const ros::Time& stamp, const ros::Time& receipt);
+
+	// messages received
+	uint64_t received() const { return received_.load(std::memory_order_relaxed); }
+	// messages skipped in the sequence and not arrived late so far
+	uint64_t lost() const { return lost_.load(std::memory_order_relaxed); }
+	// number of jumps in the sequence
+	uint64_t gaps() const { return gaps_.load(std::memory_order_relaxed); }
+	// messages counted as lost that arrived after a later one
+	uint64_t reordered() const { return reordered_.load(std::memory_order_relaxed); }
+	// messages with a sequence number that was received before
+	uint64_t duplicates() const { return duplicates_.load(std::memory_order_relaxed); }
+	uint64_t restarts() const { return restarts_.load(std::memory_order_relaxed); }
+
+	// latency from the header stamp to the callback, messages without stamp are not counted
+	double lastLatency() const { return last_latency_ns_.load(std::memory_order_relaxed) * 1e-9; }
+	double maxLatency() const { return max_latency_ns_.load(std::memory_order_relaxed) * 1e-9; }
+	double meanLatency() const;
+
+private:
+	bool started_ = false;
+	uint32_t expected_seq_ = 0;
+	// indexed by the sequence number modulo the window, set for the numbers skipped so far
+	std::bitset<kMissingWindow> missing_;
+
+	std::atomic<uint64_t> received_{ 0 };
+	std::atomic<uint64_t> lost_{ 0 };
+	std::atomic<uint64_t> gaps_{ 0 };
+	std::atomic<uint64_t> reordered_{ 0 };
+	std::atomic<uint64_t> duplicates_{ 0 };
+	std::atomic<uint64_t> restarts_{ 0 };
+
+	std::atomic<int64_t> last_latency_ns_{ 0 };
+	std::atomic<int64_t> max_latency_ns_{ 0 };
+	std::atomic<int64_t> latency_sum_ns_{ 0 };
+	std::atomic<uint64_t> latency_count_{ 0 };
+};
+
+inline void MessageStats::update(uint32_t seq, const ros::Time& stamp, const ros::Time& receipt) {
+	received_.fetch_add(1, std::memory_order_relaxed);
+
+	// sequence numbers wrap around, compare their distance
+	const int32_t distance = static_cast<int32_t>(seq - expected_seq_);
+	if (!started_ || distance < -kRestartThreshold) {
+		if (started_) restarts_.fetch_add(1, std::memory_order_relaxed);
+		started_ = true;
+		missing_.reset();
+		expected_seq_ = seq + 1;
+	} else if (distance >= 0) {
+		if (distance > 0) {
+			gaps_.fetch_add(1, std::memory_order_relaxed);
+			lost_.fetch_add(distance, std::memory_order_relaxed);
+		}
+		// only the skipped numbers still inside the window are remembered
+		const uint32_t skipped = std::min<uint32_t>(distance, kMissingWindow - 1);
+		for (uint32_t n = seq - skipped; n != seq; ++n) missing_.set(n % kMissingWindow);
+		missing_.reset(seq % kMissingWindow);
+		expected_seq_ = seq + 1;
+	} else if (missing_.test(seq % kMissingWindow)) {
+		// a message counted as lost arrived after all
+		missing_.reset(seq % kMissingWindow);
+		reordered_.fetch_add(1, std::memory_order_relaxed);
+		lost_.fetch_sub(1, std::memory_order_relaxed);
+	} else {
+		duplicates_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (stamp.isZero()) return;
+	const int64_t latency = (receipt - stamp).toNSec();
+	last_latency_ns_.store(latency, std::memory_order_relaxed);
+	if (latency > max_latency_ns_.load(std::memory_order_relaxed)) {
+		max_latency_ns_.store(latency, std::memory_order_relaxed);
+	}
+	latency_sum_ns_.fetch_add(latency, std::memory_order_relaxed);
+	latency_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline double MessageStats::meanLatency() const {
+	const uint64_t count = latency_count_.load(std::memory_order_relaxed);
+	return count ? latency_sum_ns_.load(std::memory_order_relaxed) * 1e-9 / count : 0.0;
+}
+}
+
+#endif  // KD45_CONTROLLER_MESSAGE_STATS_H
@@ -0,0 +1,108 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_SEQLOCK_H
+#define KD45_CONTROLLER_SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace kd45_controller {
+
+// single writer, multiple reader sequence lock for small trivially copyable values, e.g. sensor readings.
+// the value is stored in atomic words, so torn reads are detected by the sequence number instead of being data races.
+// readers never block the writer. a reader that keeps colliding with the writer gives up after a few attempts, the
+// realtime loop then keeps its previous value instead of spinning on a writer that may be preempted.
+template <class T>
+class SeqLock
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable value");
+
+public:
+	explicit SeqLock(const T& initial = T()) { store(initial); }
+
+	SeqLock(const SeqLock&) = delete;
+	SeqLock& operator=(const SeqLock&) = delete;
+
+	// single writer
+	void store(const T& value);
+
+	// false if the writer interfered in all attempts, value is left unchanged then
+	bool tryLoad(T& value, unsigned int attempts = 4) const;
+
+	// number of stores so far
+	uint64_t version() const { return sequence_.load(std::memory_order_acquire) / 2; }
+
+private:
+	static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint64_t> sequence_{ 0 };
+	std::atomic<uint64_t> words_[kWords];
+};
+
+template <class T>
+inline void SeqLock<T>::store(const T& value) {
+	uint64_t words[kWords] = {};
+	std::memcpy(words, &value, sizeof(T));
+
+	// odd while writing. a reader that loads any new word also sees the odd sequence afterwards, no fences needed
+	const uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+	sequence_.store(sequence + 1, std::memory_order_relaxed);
+	for (size_t i = 0; i < kWords; ++i) words_[i].store(words[i], std::memory_order_release);
+	sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+template <class T>
+inline bool SeqLock<T>::tryLoad(T& value, unsigned int attempts) const {
+	uint64_t words[kWords];
+	for (unsigned int attempt = 0; attempt < attempts; ++attempt) {
+		const uint64_t before = sequence_.load(std::memory_order_acquire);
+		if (before & 1) continue;
+		for (size_t i = 0; i < kWords; ++i) words[i] = words_[i].load(std::memory_order_acquire);
+		if (sequence_.load(std::memory_order_relaxed) != before) continue;
+
+		std::memcpy(&value, words, sizeof(T));
+		return true;
+	}
+	return false;
+}
+}
+
+#endif  // KD45_CONTROLLER_SEQLOCK_H
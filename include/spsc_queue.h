@@ -0,0 +1,106 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_SPSC_QUEUE_H
+#define KD45_CONTROLLER_SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace kd45_controller {
+
+// fixed capacity, lock-free single producer / single consumer ring buffer.
+// all storage is allocated up front, so push() and pop() never allocate and can be used from the realtime thread.
+template <class T, size_t Capacity>
+class SpscQueue
+{
+public:
+	// producer side, returns false if the queue is full
+	bool push(const T& value) {
+		const size_t head = head_.load(std::memory_order_relaxed);
+		const size_t next = (head + 1) % kSlots;
+		if (next == tail_.load(std::memory_order_acquire)) return false;
+
+		slots_[head] = value;
+		head_.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, returns false if the queue is empty
+	bool pop(T& value) {
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail == head_.load(std::memory_order_acquire)) return false;
+
+		value = slots_[tail];
+		tail_.store((tail + 1) % kSlots, std::memory_order_release);
+		return true;
+	}
+
+	// consumer side, the element stays valid until the next pop()
+	T* front() {
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail == head_.load(std::memory_order_acquire)) return nullptr;
+		return &slots_[tail];
+	}
+
+	// producer side
+	bool full() const {
+		return (head_.load(std::memory_order_relaxed) + 1) % kSlots == tail_.load(std::memory_order_acquire);
+	}
+
+	// consumer side
+	bool empty() const { return tail_.load(std::memory_order_relaxed) == head_.load(std::memory_order_acquire); }
+
+private:
+	// one slot stays empty to tell a full from an empty queue
+	static constexpr size_t kSlots = Capacity + 1;
+
+	std::array<T, kSlots> slots_;
+	// padding keeps producer and consumer index on separate cache lines, without relying on over-aligned new
+	char pad0_[64];
+	std::atomic<size_t> head_{ 0 };
+	char pad1_[64];
+	std::atomic<size_t> tail_{ 0 };
+};
+
+template <class T, size_t Capacity>
+constexpr size_t SpscQueue<T, Capacity>::kSlots;
+}
+
+#endif  // KD45_CONTROLLER_SPSC_QUEUE_H
@@ -0,0 +1,238 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_STATE_SNAPSHOT_H
+#define KD45_CONTROLLER_STATE_SNAPSHOT_H
+
+#include <ros/ros.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <latency_budget.h>
+#include <seqlock.h>
+
+namespace kd45_controller {
+
+constexpr unsigned int kSnapshotMaxJoints = 8;
+constexpr unsigned int kGoalIdSize = 64;
+
+// controller state of one cycle, as exposed in shared memory. plain data with a fixed layout, so that tools built
+// from the same headers can map it.
+template <unsigned int NumFingers>
+struct StateSnapshot
+{
+	enum GoalState : uint32_t { NO_GOAL = 0, GOAL_ACTIVE, STREAMING, IDLE };
+
+	uint64_t cycle;
+	// controller uptime and the time spent in the cycle up to the snapshot, in seconds
+	double uptime;
+	double compute_time;
+	uint32_t num_joints;
+	uint32_t goal_state;
+
+	double position[kSnapshotMaxJoints];
+	double velocity[kSnapshotMaxJoints];
+	double desired_position[kSnapshotMaxJoints];
+	double desired_velocity[kSnapshotMaxJoints];
+	double position_error[kSnapshotMaxJoints];
+	double velocity_error[kSnapshotMaxJoints];
+
+	float force[NumFingers];
+	// range of the tactile samples received since the previous cycle, and their number
+	float force_min[NumFingers];
+	float force_max[NumFingers];
+	uint32_t force_samples;
+	uint8_t contact[NumFingers];
+	// FaultDetector::Fault flags
+	uint32_t faults;
+	// LatencyBudget counters, indexed by LatencyBudget::Stage
+	uint64_t stage_overruns[LatencyBudget::NUM_STAGES];
+	uint64_t cycle_overruns;
+	uint64_t skipped_cycles;
+	// MessageStats of the tactile sensor, latencies in seconds
+	uint64_t tactile_received;
+	uint64_t tactile_lost;
+	uint64_t tactile_gaps;
+	uint64_t tactile_reordered;
+	uint64_t tactile_duplicates;
+	uint64_t tactile_restarts;
+	double tactile_mean_latency;
+	double tactile_max_latency;
+
+	// null terminated, empty without an active goal
+	char goal_id[kGoalIdSize];
+};
+
+// layout of the shared memory segment, the snapshot is written once per cycle through a sequence lock
+template <unsigned int NumFingers>
+struct SharedStateSegment
+{
+	static constexpr uint32_t kMagic = 0x3534444b;
+	static constexpr uint32_t kVersion = 6;
+
+	uint32_t magic;
+	uint32_t version;
+	uint64_t snapshot_size;
+	SeqLock<StateSnapshot<NumFingers>> state;
+};
+
+// owns the shared memory segment, created on open() and removed on destruction
+template <unsigned int NumFingers>
+class StateSnapshotWriter
+{
+public:
+	typedef SharedStateSegment<NumFingers> Segment;
+
+	StateSnapshotWriter() = default;
+	~StateSnapshotWriter();
+
+	StateSnapshotWriter(const StateSnapshotWriter&) = delete;
+	StateSnapshotWriter& operator=(const StateSnapshotWriter&) = delete;
+
+	// non-realtime, name is a POSIX shared memory name like "/kd45_state"
+	bool open(const std::string& name);
+	bool isOpen() const { return segment_ != nullptr; }
+
+	// realtime
+	void write(const StateSnapshot<NumFingers>& snapshot) { segment_->state.store(snapshot); }
+
+private:
+	std::string name_;
+	Segment* segment_ = nullptr;
+};
+
+// maps the segment of a running controller read-only, for monitoring tools
+template <unsigned int NumFingers>
+class StateSnapshotReader
+{
+public:
+	typedef SharedStateSegment<NumFingers> Segment;
+
+	StateSnapshotReader() = default;
+	~StateSnapshotReader() {
+		if (segment_) munmap(const_cast<Segment*>(segment_), sizeof(Segment));
+	}
+
+	StateSnapshotReader(const StateSnapshotReader&) = delete;
+	StateSnapshotReader& operator=(const StateSnapshotReader&) = delete;
+
+	// false if there is no segment of that name or it has a different layout
+	bool open(const std::string& name);
+
+	// false if the controller kept writing during all attempts
+	bool read(StateSnapshot<NumFingers>& snapshot) const { return segment_->state.tryLoad(snapshot, 16); }
+
+private:
+	const Segment* segment_ = nullptr;
+};
+
+template <unsigned int NumFingers>
+constexpr uint32_t SharedStateSegment<NumFingers>::kMagic;
+template <unsigned int NumFingers>
+constexpr uint32_t SharedStateSegment<NumFingers>::kVersion;
+
+template <unsigned int NumFingers>
+inline StateSnapshotWriter<NumFingers>::~StateSnapshotWriter() {
+	if (!segment_) return;
+	segment_->~Segment();
+	munmap(segment_, sizeof(Segment));
+	shm_unlink(name_.c_str());
+}
+
+template <unsigned int NumFingers>
+inline bool StateSnapshotWriter<NumFingers>::open(const std::string& name) {
+	const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		ROS_ERROR_STREAM_NAMED("KD45C", "Can't open shared memory \"" << name << "\": " << std::strerror(errno));
+		return false;
+	}
+	if (ftruncate(fd, sizeof(Segment)) < 0) {
+		ROS_ERROR_STREAM_NAMED("KD45C", "Can't resize shared memory \"" << name << "\": " << std::strerror(errno));
+		::close(fd);
+		return false;
+	}
+	void* memory = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (memory == MAP_FAILED) {
+		ROS_ERROR_STREAM_NAMED("KD45C", "Can't map shared memory \"" << name << "\": " << std::strerror(errno));
+		return false;
+	}
+
+	// readers check the header before they trust the layout
+	segment_ = new (memory) Segment();
+	segment_->snapshot_size = sizeof(StateSnapshot<NumFingers>);
+	segment_->version = Segment::kVersion;
+	segment_->magic = Segment::kMagic;
+	name_ = name;
+	return true;
+}
+
+template <unsigned int NumFingers>
+inline bool StateSnapshotReader<NumFingers>::open(const std::string& name) {
+	const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) return false;
+
+	struct stat info;
+	void* memory = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(Segment)) {
+		memory = mmap(nullptr, sizeof(Segment), PROT_READ, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (memory == MAP_FAILED) return false;
+
+	const Segment* segment = static_cast<const Segment*>(memory);
+	if (segment->magic != Segment::kMagic || segment->version != Segment::kVersion ||
+	    segment->snapshot_size != sizeof(StateSnapshot<NumFingers>)) {
+		munmap(memory, sizeof(Segment));
+		return false;
+	}
+	segment_ = segment;
+	return true;
+}
+}
+
+#endif  // KD45_CONTROLLER_STATE_SNAPSHOT_H
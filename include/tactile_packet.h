@@ -0,0 +1,109 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_TACTILE_PACKET_H
+#define KD45_CONTROLLER_TACTILE_PACKET_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace kd45_controller {
+
+// fixed layout UDP datagram carrying one tactile reading, all fields little-endian:
+//   0  uint32  magic "KD45"
+//   4  uint16  version
+//   6  uint16  number of forces
+//   8  uint32  sequence number
+//  12  uint32  stamp seconds
+//  16  uint32  stamp nanoseconds
+//  20  float   forces[number of forces]
+// the byte layout is fixed, the encode and decode helpers copy field by field and assume a little-endian host.
+template <unsigned int NumForces>
+struct TactilePacket
+{
+	static constexpr uint32_t kMagic = 0x3534444b;
+	static constexpr uint16_t kVersion = 1;
+	static constexpr size_t kHeaderSize = 20;
+	static constexpr size_t kSize = kHeaderSize + NumForces * sizeof(float);
+
+	uint32_t seq = 0;
+	uint32_t sec = 0;
+	uint32_t nsec = 0;
+	std::array<float, NumForces> forces{};
+
+	void encode(uint8_t* buffer) const {
+		const uint16_t count = NumForces;
+		std::memcpy(buffer, &kMagic, 4);
+		std::memcpy(buffer + 4, &kVersion, 2);
+		std::memcpy(buffer + 6, &count, 2);
+		std::memcpy(buffer + 8, &seq, 4);
+		std::memcpy(buffer + 12, &sec, 4);
+		std::memcpy(buffer + 16, &nsec, 4);
+		std::memcpy(buffer + kHeaderSize, forces.data(), NumForces * sizeof(float));
+	}
+
+	// false if the datagram is not a packet of this layout
+	bool decode(const uint8_t* buffer, size_t size) {
+		uint32_t magic;
+		uint16_t version, count;
+		if (size != kSize) return false;
+		std::memcpy(&magic, buffer, 4);
+		std::memcpy(&version, buffer + 4, 2);
+		std::memcpy(&count, buffer + 6, 2);
+		if (magic != kMagic || version != kVersion || count != NumForces) return false;
+
+		std::memcpy(&seq, buffer + 8, 4);
+		std::memcpy(&sec, buffer + 12, 4);
+		std::memcpy(&nsec, buffer + 16, 4);
+		std::memcpy(forces.data(), buffer + kHeaderSize, NumForces * sizeof(float));
+		return true;
+	}
+};
+
+template <unsigned int NumForces>
+constexpr uint32_t TactilePacket<NumForces>::kMagic;
+template <unsigned int NumForces>
+constexpr uint16_t TactilePacket<NumForces>::kVersion;
+template <unsigned int NumForces>
+constexpr size_t TactilePacket<NumForces>::kHeaderSize;
+template <unsigned int NumForces>
+constexpr size_t TactilePacket<NumForces>::kSize;
+}
+
+#endif  // KD45_CONTROLLER_TACTILE_PACKET_H
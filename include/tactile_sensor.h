@@ -41,33 +41,71 @@
 #include <kd45_controller.h>
 #include <tactile_msgs/TactileState.h>
 
+#include <message_stats.h>
+#include <tactile_packet.h>
+
+#include <atomic>
+#include <thread>
+
 namespace kd45_controller {
 class TactileSensorBase {
 public:
-    TactileSensorBase(ros::NodeHandle& root_nh, std::shared_ptr<std::vector<float>> forces, bool simulation);
+    TactileSensorBase(ros::NodeHandle& root_nh, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+                      std::shared_ptr<ForceLimit<kNumFingers>> force_limit, bool simulation);
     virtual void update() {};
 
+    // loss, reordering and latency of the received messages, stays empty for sensors without sequence numbers
+    const MessageStats& stats() const { return stats_; }
+
     bool sim = false;
 protected:
+    // checks a sample against the force limit, without storing it
+    void check_(const Forces& forces, const ros::Time& stamp) { force_limit_->check(forces, stamp); }
+
     ros::NodeHandle& nh_;
-    std::shared_ptr<std::vector<float>> forces_;
+    std::shared_ptr<ForceChannel<kNumFingers>> forces_;
+    std::shared_ptr<ForceLimit<kNumFingers>> force_limit_;
+    MessageStats stats_;
 };
 
 // listens to topic for simulation use
 class TactileSensorSim : public TactileSensorBase
 {
 public:
-    TactileSensorSim(ros::NodeHandle& root_nh, std::shared_ptr<std::vector<float>> forces);
+    TactileSensorSim(ros::NodeHandle& root_nh, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+                     std::shared_ptr<ForceLimit<kNumFingers>> force_limit);
 private:
     ros::Subscriber sub_;
     void sensor_cb_(const tactile_msgs::TactileStateConstPtr tactile_state);
 };
 
+// receives TactilePacket datagrams over UDP, unicast or multicast, for lower latency than the topic
+class TactileSensorUdp : public TactileSensorBase
+{
+public:
+    typedef TactilePacket<kNumFingers> Packet;
+
+    TactileSensorUdp(ros::NodeHandle& root_nh, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+                     std::shared_ptr<ForceLimit<kNumFingers>> force_limit);
+    ~TactileSensorUdp();
+private:
+    // datagrams received with a single recvmmsg call. only used as a value, so it needs no definition outside the class
+    static constexpr unsigned int kBatchSize = 16;
+
+    bool open_(const std::string& address, int port);
+    void receive_();
+
+    int socket_ = -1;
+    std::atomic<bool> running_{ false };
+    std::thread thread_;
+};
+
 // reads from real sensors
 class TactileSensorReal : public TactileSensorBase
 {
 public:
-	TactileSensorReal(ros::NodeHandle& root_nh, std::shared_ptr<std::vector<float>> forces);
+	TactileSensorReal(ros::NodeHandle& root_nh, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+	                  std::shared_ptr<ForceLimit<kNumFingers>> force_limit);
 };
 }
 
@@ -39,21 +39,150 @@
 
 #include <tactile_sensor.h>
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
 namespace kd45_controller {
-TactileSensorBase::TactileSensorBase(ros::NodeHandle& nh, std::shared_ptr<std::vector<float>> forces, bool simulation) : nh_(nh), forces_(forces), sim(simulation){}
+TactileSensorBase::TactileSensorBase(ros::NodeHandle& nh, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+                                     std::shared_ptr<ForceLimit<kNumFingers>> force_limit, bool simulation)
+    : nh_(nh), forces_(forces), force_limit_(force_limit), sim(simulation){}
 
-TactileSensorSim::TactileSensorSim(ros::NodeHandle& nh, std::shared_ptr<std::vector<float>> forces) : TactileSensorBase(nh, forces, true) {
+TactileSensorSim::TactileSensorSim(ros::NodeHandle& nh, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+                                   std::shared_ptr<ForceLimit<kNumFingers>> force_limit)
+    : TactileSensorBase(nh, forces, force_limit, true) {
     sub_ = nh.subscribe("/kd45_tactile", 0, &TactileSensorSim::sensor_cb_, this);
     ROS_INFO_STREAM("Registered subscriber for \"/kd45_tactile\"");
 }
 
 void TactileSensorSim::sensor_cb_(const tactile_msgs::TactileStateConstPtr ts) {
-    for (int i = 0; i < forces_->size(); i++){ // lock here?
-        (*forces_)[i] = ts->sensors[i].values[0];
+    stats_.update(ts->header.seq, ts->header.stamp, ros::Time::now());
+    ROS_DEBUG_STREAM_THROTTLE_NAMED(1, "KD45C.tactile", "Tactile messages received: " << stats_.received()
+        << ", lost: " << stats_.lost() << " in " << stats_.gaps() << " gaps, reordered: " << stats_.reordered()
+        << ", duplicates: " << stats_.duplicates() << ", latency mean/max: " << stats_.meanLatency() << "s/"
+        << stats_.maxLatency() << "s");
+
+    Forces forces{};
+    for (size_t i = 0; i < forces.size() && i < ts->sensors.size(); i++){
+        if (!ts->sensors[i].values.empty()) forces[i] = ts->sensors[i].values[0];
+    }
+    check_(forces, ts->header.stamp);
+    forces_->store(forces);
+}
+
+TactileSensorUdp::TactileSensorUdp(ros::NodeHandle& nh, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+                                   std::shared_ptr<ForceLimit<kNumFingers>> force_limit)
+    : TactileSensorBase(nh, forces, force_limit, false) {
+    ros::NodeHandle udp_nh(nh, "kd45_tactile_udp");
+    std::string address;
+    int port;
+    udp_nh.param<std::string>("address", address, "127.0.0.1");
+    udp_nh.param("port", port, 45045);
+
+    if (!open_(address, port)) {
+        if (socket_ >= 0) close(socket_);
+        socket_ = -1;
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread(&TactileSensorUdp::receive_, this);
+    ROS_INFO_STREAM("Receiving tactile datagrams on " << address << ":" << port);
+}
+
+TactileSensorUdp::~TactileSensorUdp() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    if (socket_ >= 0) close(socket_);
+}
+
+bool TactileSensorUdp::open_(const std::string& address, int port) {
+    in_addr group;
+    if (inet_pton(AF_INET, address.c_str(), &group) != 1) {
+        ROS_ERROR_STREAM("Invalid tactile UDP address \"" << address << "\"");
+        return false;
+    }
+
+    socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_ < 0) {
+        ROS_ERROR_STREAM("Can't create tactile UDP socket: " << std::strerror(errno));
+        return false;
+    }
+
+    // several consumers may listen to the same multicast group
+    const int reuse = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    // wake up regularly to check for shutdown
+    timeval timeout{ 0, 100000 };
+    setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    const bool multicast = IN_MULTICAST(ntohl(group.s_addr));
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr.s_addr = multicast ? htonl(INADDR_ANY) : group.s_addr;
+    if (bind(socket_, reinterpret_cast<sockaddr*>(&local), sizeof(local)) < 0) {
+        ROS_ERROR_STREAM("Can't bind tactile UDP socket to port " << port << ": " << std::strerror(errno));
+        return false;
+    }
+
+    if (multicast) {
+        ip_mreq membership{};
+        membership.imr_multiaddr = group;
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(socket_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0) {
+            ROS_ERROR_STREAM("Can't join tactile multicast group " << address << ": " << std::strerror(errno));
+            return false;
+        }
+    }
+    return true;
+}
+
+void TactileSensorUdp::receive_() {
+    // one oversized buffer per datagram, so packets of a different layout are seen as such instead of truncated
+    uint8_t buffers[kBatchSize][Packet::kSize + 1];
+    iovec iovecs[kBatchSize];
+    mmsghdr messages[kBatchSize];
+
+    while (running_) {
+        std::memset(messages, 0, sizeof(messages));
+        for (unsigned int i = 0; i < kBatchSize; i++) {
+            iovecs[i].iov_base = buffers[i];
+            iovecs[i].iov_len = sizeof(buffers[i]);
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        // blocks for the first datagram only, then takes whatever else is queued
+        const int received = recvmmsg(socket_, messages, kBatchSize, MSG_WAITFORONE, nullptr);
+        if (received <= 0) continue;
+        const ros::Time receipt = ros::Time::now();
+
+        // only the newest reading of a batch is relevant for the controller
+        Packet packet, newest;
+        bool valid = false;
+        for (int i = 0; i < received; i++) {
+            if (!packet.decode(buffers[i], messages[i].msg_len)) {
+                ROS_WARN_THROTTLE(1, "Dropping malformed tactile datagram");
+                continue;
+            }
+            stats_.update(packet.seq, ros::Time(packet.sec, packet.nsec), receipt);
+            // every sample of the batch, a short peak must not hide behind a newer reading
+            check_(packet.forces, ros::Time(packet.sec, packet.nsec));
+            forces_->accumulate(packet.forces);
+            if (!valid || static_cast<int32_t>(packet.seq - newest.seq) > 0) newest = packet;
+            valid = true;
+        }
+        if (valid) forces_->publish(newest.forces);
     }
 }
 
-    TactileSensorReal::TactileSensorReal(ros::NodeHandle& nh, std::shared_ptr<std::vector<float>> forces) : TactileSensorBase(nh, forces, false) {}
+    TactileSensorReal::TactileSensorReal(ros::NodeHandle& nh, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+                                         std::shared_ptr<ForceLimit<kNumFingers>> force_limit)
+        : TactileSensorBase(nh, forces, force_limit, false) {}
 }
 
 #endif  // KD45_CONTROLLER_TACTILE_SENSOR_IMPL_H
@@ -0,0 +1,136 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_TACTILE_SUMMARY_H
+#define KD45_CONTROLLER_TACTILE_SUMMARY_H
+
+#include <ros/ros.h>
+#include <tactile_msgs/TactileState.h>
+
+#include <array>
+#include <memory>
+
+#include <force_channel.h>
+
+namespace kd45_controller {
+
+// publishes the forces seen by the controller, with contact flags and force rates, on "tactile_summary".
+// runs on a non-realtime timer from snapshots of the forces, the control loop does no extra work for it. the message
+// is preallocated once, every publication only overwrites its values.
+// message layout: one tactile_msgs/TactileSensor per quantity, with one value per finger
+//   "force"        force per finger
+//   "contact"      1 if the force is above the contact threshold, 0 otherwise
+//   "force_rate"   change of the force per second since the last publication
+//   "total_force"  sum of the finger forces, single value
+template <unsigned int NumFingers>
+class TactileSummaryPublisher
+{
+public:
+	typedef std::array<float, NumFingers> Forces;
+
+	// reads the "tactile_summary" namespace, a rate <= 0 disables publishing
+	void init(ros::NodeHandle& nh, const std::shared_ptr<ForceChannel<NumFingers>>& forces, double contact_threshold);
+
+private:
+	enum Field { FORCE = 0, CONTACT, FORCE_RATE, TOTAL_FORCE, NUM_FIELDS };
+
+	void publish(const ros::TimerEvent& event);
+
+	std::shared_ptr<ForceChannel<NumFingers>> forces_;
+	double contact_threshold_ = 0.0;
+
+	ros::Publisher pub_;
+	ros::Timer timer_;
+	tactile_msgs::TactileState msg_;
+
+	Forces last_forces_{};
+	ros::Time last_stamp_;
+};
+
+template <unsigned int NumFingers>
+inline void TactileSummaryPublisher<NumFingers>::init(ros::NodeHandle& nh,
+                                                      const std::shared_ptr<ForceChannel<NumFingers>>& forces,
+                                                      double contact_threshold) {
+	ros::NodeHandle summary_nh(nh, "tactile_summary");
+	double rate = 0.0;
+	summary_nh.param("rate", rate, 0.0);
+	if (rate <= 0.0) return;
+	contact_threshold_ = contact_threshold;
+
+	forces_ = forces;
+	msg_.sensors.resize(NUM_FIELDS);
+	msg_.sensors[FORCE].name = "force";
+	msg_.sensors[CONTACT].name = "contact";
+	msg_.sensors[FORCE_RATE].name = "force_rate";
+	msg_.sensors[TOTAL_FORCE].name = "total_force";
+	for (unsigned int i = FORCE; i < TOTAL_FORCE; ++i) msg_.sensors[i].values.resize(NumFingers);
+	msg_.sensors[TOTAL_FORCE].values.resize(1);
+
+	pub_ = nh.advertise<tactile_msgs::TactileState>("tactile_summary", 10);
+	timer_ = nh.createTimer(ros::Duration(1.0 / rate), &TactileSummaryPublisher::publish, this);
+	ROS_INFO_STREAM_NAMED("KD45C", "Publishing the tactile summary at " << rate << "Hz");
+}
+
+template <unsigned int NumFingers>
+inline void TactileSummaryPublisher<NumFingers>::publish(const ros::TimerEvent& /*event*/) {
+	if (pub_.getNumSubscribers() == 0) return;
+
+	Forces forces;
+	if (!forces_->tryLoad(forces)) return;
+
+	const ros::Time now = ros::Time::now();
+	const double dt = last_stamp_.isZero() ? 0.0 : (now - last_stamp_).toSec();
+	float total = 0.0f;
+	for (unsigned int i = 0; i < NumFingers; ++i) {
+		msg_.sensors[FORCE].values[i] = forces[i];
+		msg_.sensors[CONTACT].values[i] = forces[i] > contact_threshold_ ? 1.0f : 0.0f;
+		msg_.sensors[FORCE_RATE].values[i] = dt > 0.0 ? (forces[i] - last_forces_[i]) / dt : 0.0f;
+		total += forces[i];
+	}
+	msg_.sensors[TOTAL_FORCE].values[0] = total;
+
+	msg_.header.seq++;
+	msg_.header.stamp = now;
+	pub_.publish(msg_);
+
+	last_forces_ = forces;
+	last_stamp_ = now;
+}
+}
+
+#endif  // KD45_CONTROLLER_TACTILE_SUMMARY_H
@@ -0,0 +1,85 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_VELOCITY_OBSERVER_H
+#define KD45_CONTROLLER_VELOCITY_OBSERVER_H
+
+#include <vector>
+
+namespace kd45_controller {
+
+// first order low-pass filtered finite difference of the joint positions.
+// used to predict the joint state forward in time, independent of the velocity estimate of the hardware.
+template <class Scalar>
+class VelocityObserver
+{
+public:
+	// gain in (0, 1], 1 gives the raw finite difference
+	void init(unsigned int n_joints, Scalar gain) {
+		gain_ = gain;
+		last_position_.assign(n_joints, 0.0);
+		velocity_.assign(n_joints, 0.0);
+		initialized_.assign(n_joints, false);
+	}
+
+	void reset() { initialized_.assign(initialized_.size(), false); }
+
+	void update(unsigned int i, Scalar position, Scalar dt) {
+		if (!initialized_[i] || dt <= 0.0) {
+			velocity_[i] = 0.0;
+			initialized_[i] = true;
+		} else {
+			velocity_[i] += gain_ * ((position - last_position_[i]) / dt - velocity_[i]);
+		}
+		last_position_[i] = position;
+	}
+
+	Scalar velocity(unsigned int i) const { return velocity_[i]; }
+
+	// position of joint i after the given horizon, assuming constant velocity
+	Scalar predict(unsigned int i, Scalar position, Scalar horizon) const { return position + velocity_[i] * horizon; }
+
+private:
+	Scalar gain_ = 1.0;
+	std::vector<Scalar> last_position_;
+	std::vector<Scalar> velocity_;
+	std::vector<bool> initialized_;
+};
+}
+
+#endif  // KD45_CONTROLLER_VELOCITY_OBSERVER_H
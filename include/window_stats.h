@@ -0,0 +1,109 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#ifndef KD45_CONTROLLER_WINDOW_STATS_H
+#define KD45_CONTROLLER_WINDOW_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace kd45_controller {
+
+// statistics over the last samples of a signal, kept in a fixed ring buffer. push() is constant time, the statistics
+// scan the window. Realtime safe.
+template <class T, std::size_t Capacity>
+class WindowStats
+{
+public:
+	struct Summary
+	{
+		T min;
+		T max;
+		T mean;
+		T last;
+	};
+
+	// number of samples in the window, at most Capacity. Clears the window
+	void resize(std::size_t length) {
+		length_ = std::min(std::max<std::size_t>(length, 1), Capacity);
+		clear();
+	}
+
+	void clear() {
+		size_ = 0;
+		next_ = 0;
+	}
+
+	void push(T value) {
+		samples_[next_] = value;
+		next_ = next_ + 1 == length_ ? 0 : next_ + 1;
+		if (size_ < length_) ++size_;
+	}
+
+	std::size_t size() const { return size_; }
+	std::size_t length() const { return length_; }
+	bool full() const { return size_ == length_; }
+	bool empty() const { return size_ == 0; }
+
+	// the window must not be empty
+	Summary summary() const {
+		Summary summary;
+		summary.last = samples_[next_ == 0 ? length_ - 1 : next_ - 1];
+		summary.min = summary.max = summary.last;
+		double sum = 0.0;
+		for (std::size_t i = 0; i < size_; ++i) {
+			summary.min = std::min(summary.min, samples_[i]);
+			summary.max = std::max(summary.max, samples_[i]);
+			sum += samples_[i];
+		}
+		summary.mean = static_cast<T>(sum / size_);
+		return summary;
+	}
+
+private:
+	std::array<T, Capacity> samples_{};
+	std::size_t length_ = Capacity;
+	std::size_t size_ = 0;
+	std::size_t next_ = 0;
+};
+}
+
+#endif  // KD45_CONTROLLER_WINDOW_STATS_H
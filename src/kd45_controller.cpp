@@ -44,6 +44,60 @@ typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensor
 
 typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorReal>
     KD45TrajectoryRealController;
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorUdp>
+    KD45TrajectoryUdpController;
+
+// cheaper to sample than the default quintic splines
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorSim,
+                                                  hardware_interface::PositionJointInterface,
+                                                  kd45_controller::LinearSegment<double>>
+    KD45LinearTrajectorySimController;
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorReal,
+                                                  hardware_interface::PositionJointInterface,
+                                                  kd45_controller::LinearSegment<double>>
+    KD45LinearTrajectoryRealController;
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorSim,
+                                                  hardware_interface::PositionJointInterface,
+                                                  kd45_controller::CubicSplineSegment<double>>
+    KD45CubicTrajectorySimController;
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorReal,
+                                                  hardware_interface::PositionJointInterface,
+                                                  kd45_controller::CubicSplineSegment<double>>
+    KD45CubicTrajectoryRealController;
+}
+
+namespace kd45_velocity_controller {
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorSim,
+                                                  hardware_interface::VelocityJointInterface>
+    KD45TrajectorySimController;
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorReal,
+                                                  hardware_interface::VelocityJointInterface>
+    KD45TrajectoryRealController;
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorUdp,
+                                                  hardware_interface::VelocityJointInterface>
+    KD45TrajectoryUdpController;
+}
+
+namespace kd45_effort_controller {
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorSim,
+                                                  hardware_interface::EffortJointInterface>
+    KD45TrajectorySimController;
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorReal,
+                                                  hardware_interface::EffortJointInterface>
+    KD45TrajectoryRealController;
+
+typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensorUdp,
+                                                  hardware_interface::EffortJointInterface>
+    KD45TrajectoryUdpController;
 }
 
 // Pluginlib
@@ -52,4 +106,26 @@ typedef kd45_controller::KD45TrajectoryController<kd45_controller::TactileSensor
 PLUGINLIB_EXPORT_CLASS(kd45_position_controller::KD45TrajectorySimController,
                        controller_interface::ControllerBase)
 PLUGINLIB_EXPORT_CLASS(kd45_position_controller::KD45TrajectoryRealController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_position_controller::KD45TrajectoryUdpController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_position_controller::KD45LinearTrajectorySimController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_position_controller::KD45LinearTrajectoryRealController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_position_controller::KD45CubicTrajectorySimController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_position_controller::KD45CubicTrajectoryRealController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_velocity_controller::KD45TrajectorySimController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_velocity_controller::KD45TrajectoryRealController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_velocity_controller::KD45TrajectoryUdpController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_effort_controller::KD45TrajectorySimController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_effort_controller::KD45TrajectoryRealController,
+                       controller_interface::ControllerBase)
+PLUGINLIB_EXPORT_CLASS(kd45_effort_controller::KD45TrajectoryUdpController,
                        controller_interface::ControllerBase)
\ No newline at end of file
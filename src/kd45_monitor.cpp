@@ -0,0 +1,201 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+// Terminal monitor for KD45TrajectoryController, reads the state snapshot the controller exports to shared memory
+// (state_shm/name). Samples every controller cycle it can see and redraws at the refresh rate, without ROS.
+//
+//   rosrun kd45_controller kd45_monitor [shm name, default /kd45_state] [refresh rate in Hz, default 50]
+
+#include <kd45_controller.h>
+#include <state_snapshot.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+typedef kd45_controller::StateSnapshot<kd45_controller::kNumFingers> Snapshot;
+
+// compute times of the last sampled cycles, for the percentiles
+constexpr size_t kWindow = 2000;
+
+std::atomic<bool> running{ true };
+
+void stop(int /*signal*/) {
+	running = false;
+}
+
+const char* goalState(uint32_t state) {
+	switch (state) {
+		case Snapshot::NO_GOAL:
+			return "no goal";
+		case Snapshot::GOAL_ACTIVE:
+			return "goal active";
+		case Snapshot::STREAMING:
+			return "streaming";
+		case Snapshot::IDLE:
+			return "idle";
+		default:
+			return "unknown";
+	}
+}
+
+double percentile(std::vector<double>& samples, double p) {
+	if (samples.empty()) return 0.0;
+	const size_t n = std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+	return samples[n];
+}
+
+void draw(const Snapshot& s, const std::string& name, std::vector<double>& window, uint64_t sampled, uint64_t missed) {
+	// home and clear, then draw from the top
+	std::printf("\033[H\033[2J");
+	std::printf("KD45 controller state (%s)   cycle %llu   uptime %.3fs\n\n", name.c_str(),
+	            static_cast<unsigned long long>(s.cycle), s.uptime);
+
+	std::printf("%-6s %10s %10s %10s %10s %10s\n", "joint", "position", "desired", "error", "velocity", "vel error");
+	for (unsigned int i = 0; i < s.num_joints && i < kd45_controller::kSnapshotMaxJoints; ++i) {
+		std::printf("%-6u %10.4f %10.4f %10.4f %10.4f %10.4f\n", i, s.position[i], s.desired_position[i],
+		            s.position_error[i], s.velocity[i], s.velocity_error[i]);
+	}
+
+	std::printf("\n%-6s %10s %10s %10s %10s   (%u samples in the cycle)\n", "finger", "force", "min", "max", "contact",
+	            s.force_samples);
+	for (unsigned int i = 0; i < kd45_controller::kNumFingers; ++i) {
+		std::printf("%-6u %10.4f %10.4f %10.4f %10s\n", i, s.force[i], s.force_min[i], s.force_max[i],
+		            s.contact[i] ? "yes" : "no");
+	}
+
+	std::printf("\ncompute time [us]  p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f   (%zu cycles)\n",
+	            percentile(window, 0.5) * 1e6, percentile(window, 0.9) * 1e6, percentile(window, 0.99) * 1e6,
+	            percentile(window, 1.0) * 1e6, window.size());
+	std::printf("cycles sampled %llu, not seen %llu\n", static_cast<unsigned long long>(sampled),
+	            static_cast<unsigned long long>(missed));
+	typedef kd45_controller::LatencyBudget Budget;
+	std::printf("over budget:");
+	for (int i = 0; i < Budget::NUM_STAGES; ++i) {
+		std::printf(" %s %llu,", Budget::stageName(static_cast<Budget::Stage>(i)),
+		            static_cast<unsigned long long>(s.stage_overruns[i]));
+	}
+	std::printf(" cycle %llu, skipped %llu\n", static_cast<unsigned long long>(s.cycle_overruns),
+	            static_cast<unsigned long long>(s.skipped_cycles));
+	std::printf("tactile messages %llu, lost %llu in %llu gaps, reordered %llu, duplicates %llu, restarts %llu, "
+	            "latency mean %.1fus max %.1fus\n",
+	            static_cast<unsigned long long>(s.tactile_received), static_cast<unsigned long long>(s.tactile_lost),
+	            static_cast<unsigned long long>(s.tactile_gaps), static_cast<unsigned long long>(s.tactile_reordered),
+	            static_cast<unsigned long long>(s.tactile_duplicates),
+	            static_cast<unsigned long long>(s.tactile_restarts), s.tactile_mean_latency * 1e6,
+	            s.tactile_max_latency * 1e6);
+	std::printf("\ngoal: %s %s\n", goalState(s.goal_state), s.goal_id);
+
+	typedef kd45_controller::FaultDetector<double, kd45_controller::kNumFingers> Faults;
+	std::printf("faults:");
+	if (s.faults == Faults::NONE) std::printf(" none");
+	for (uint32_t fault = Faults::BLOCKED; fault <= Faults::ASYMMETRY; fault <<= 1) {
+		if (s.faults & fault) std::printf(" [%s]", Faults::describe(static_cast<Faults::Fault>(fault)));
+	}
+	std::printf("\n");
+	std::fflush(stdout);
+}
+}
+
+int main(int argc, char** argv) {
+	const std::string name = argc > 1 ? argv[1] : "/kd45_state";
+	const double rate = argc > 2 ? std::atof(argv[2]) : 50.0;
+	if (rate <= 0.0) {
+		std::fprintf(stderr, "refresh rate has to be positive\n");
+		return 1;
+	}
+
+	kd45_controller::StateSnapshotReader<kd45_controller::kNumFingers> reader;
+	if (!reader.open(name)) {
+		std::fprintf(stderr, "Can't open controller state \"%s\", is state_shm/name set?\n", name.c_str());
+		return 1;
+	}
+
+	std::signal(SIGINT, stop);
+	std::signal(SIGTERM, stop);
+
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration refresh_period =
+	    std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+	Clock::time_point next_refresh = Clock::now();
+
+	Snapshot snapshot{};
+	std::vector<double> compute_times;
+	compute_times.reserve(kWindow);
+	std::vector<double> window;
+	window.reserve(kWindow);
+	size_t next_sample = 0;
+	uint64_t last_cycle = 0, sampled = 0, missed = 0;
+
+	// hide the cursor while drawing
+	std::printf("\033[?25l");
+	while (running) {
+		if (reader.read(snapshot) && snapshot.cycle != last_cycle) {
+			if (last_cycle != 0 && snapshot.cycle > last_cycle + 1) missed += snapshot.cycle - last_cycle - 1;
+			last_cycle = snapshot.cycle;
+			++sampled;
+
+			if (compute_times.size() < kWindow) {
+				compute_times.push_back(snapshot.compute_time);
+			} else {
+				compute_times[next_sample] = snapshot.compute_time;
+			}
+			next_sample = (next_sample + 1) % kWindow;
+		}
+
+		const Clock::time_point now = Clock::now();
+		if (now >= next_refresh) {
+			window.assign(compute_times.begin(), compute_times.end());
+			draw(snapshot, name, window, sampled, missed);
+			next_refresh = now + refresh_period;
+		}
+
+		// sample well above typical control rates, the snapshot itself is updated once per cycle
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	std::printf("\033[?25h\n");
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+// Compares the per-cycle cost of sampling a gripper trajectory with the segment types the controller can be built
+// with: the quintic spline of the JTC base class and the cubic and linear segments of this package. Runs without a
+// ROS master, e.g. rosrun kd45_controller kd45_sampling_benchmark [cycles]
+
+#include <trajectory_interface/quintic_spline_segment.h>
+#include <trajectory_interface/trajectory_interface.h>
+
+#include <cubic_spline_segment.h>
+#include <linear_segment.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// one joint per finger
+const unsigned int kJoints = 2;
+// a 2s grasp motion through 20 waypoints, sampled at 1kHz
+const unsigned int kWaypoints = 20;
+const double kDuration = 2.0;
+const double kPeriod = 0.001;
+const unsigned int kRuns = 5;
+
+// one trajectory per joint like the controller keeps them, waypoints with positions, velocities and accelerations
+template <class Segment>
+std::vector<std::vector<Segment>> makeTrajectory() {
+	typedef typename Segment::State State;
+	std::vector<std::vector<Segment>> trajectory(kJoints);
+	for (unsigned int joint = 0; joint < kJoints; ++joint) {
+		State start(1), end(1);
+		auto waypoint = [joint](double t, State& state) {
+			const double w = M_PI / kDuration;
+			state.position[0] = 0.02 * (1.0 + std::cos(w * t)) + 0.001 * joint;
+			state.velocity[0] = -0.02 * w * std::sin(w * t);
+			state.acceleration[0] = -0.02 * w * w * std::cos(w * t);
+		};
+		for (unsigned int i = 0; i < kWaypoints; ++i) {
+			const double start_time = kDuration * i / kWaypoints;
+			const double end_time = kDuration * (i + 1) / kWaypoints;
+			waypoint(start_time, start);
+			waypoint(end_time, end);
+			trajectory[joint].push_back(Segment(start_time, start, end_time, end));
+		}
+	}
+	return trajectory;
+}
+
+// nanoseconds per control cycle, sampling every joint like KD45TrajectoryController::update(). The best of a few
+// runs, the others are slowed down by the rest of the machine
+template <class Segment>
+double benchmark(unsigned long cycles, double& checksum) {
+	const std::vector<std::vector<Segment>> trajectory = makeTrajectory<Segment>();
+	typename Segment::State state(1);
+	const unsigned long cycles_per_pass = static_cast<unsigned long>(kDuration / kPeriod);
+
+	double best = std::numeric_limits<double>::infinity();
+	for (unsigned int run = 0; run < kRuns; ++run) {
+		const auto start = std::chrono::steady_clock::now();
+		for (unsigned long cycle = 0; cycle < cycles; ++cycle) {
+			const double time = (cycle % cycles_per_pass) * kPeriod;
+			for (unsigned int joint = 0; joint < kJoints; ++joint) {
+				trajectory_interface::sample(trajectory[joint], time, state);
+				checksum += state.position[0] + state.velocity[0];
+			}
+		}
+		const auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / cycles);
+	}
+	return best;
+}
+}
+
+int main(int argc, char** argv) {
+	const unsigned long cycles = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+	if (cycles == 0) {
+		std::fprintf(stderr, "usage: %s [cycles]\n", argv[0]);
+		return 1;
+	}
+
+	// the checksum keeps the compiler from dropping the sampling
+	double checksum = 0.0;
+	std::printf("%lu cycles, %u joints, %u segments per joint, best of %u runs\n", cycles, kJoints, kWaypoints, kRuns);
+	std::printf("%-10s %10s\n", "segment", "ns/cycle");
+	typedef trajectory_interface::QuinticSplineSegment<double> Quintic;
+	std::printf("%-10s %10.1f\n", "quintic", benchmark<Quintic>(cycles, checksum));
+	std::printf("%-10s %10.1f\n", "cubic", benchmark<kd45_controller::CubicSplineSegment<double>>(cycles, checksum));
+	std::printf("%-10s %10.1f\n", "linear", benchmark<kd45_controller::LinearSegment<double>>(cycles, checksum));
+	std::printf("checksum %g\n", checksum);
+	return 0;
+}
@@ -0,0 +1,148 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+// Publishes synthetic tactile data on /kd45_tactile, for load testing TactileSensorSim.
+// The first taxel of every sensor carries the force read by the controller, header.seq and header.stamp are set for
+// every message so the receiving side can detect loss and measure latency.
+// With ~udp/address set, the forces are also sent as TactilePacket datagrams for TactileSensorUdp.
+
+#include <ros/ros.h>
+#include <tactile_msgs/TactileState.h>
+
+#include <kd45_controller.h>
+#include <tactile_packet.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+typedef kd45_controller::TactilePacket<kd45_controller::kNumFingers> Packet;
+
+int main(int argc, char** argv) {
+	ros::init(argc, argv, "kd45_tactile_generator");
+	ros::NodeHandle nh;
+	ros::NodeHandle pnh("~");
+
+	double rate, amplitude, offset, frequency;
+	int sensors, taxels;
+	pnh.param("rate", rate, 1000.0);
+	pnh.param("sensors", sensors, 2);
+	pnh.param("taxels", taxels, 64);
+	pnh.param("force/amplitude", amplitude, 1.0);
+	pnh.param("force/offset", offset, 1.0);
+	pnh.param("force/frequency", frequency, 0.5);
+
+	std::string udp_address;
+	int udp_port;
+	pnh.param<std::string>("udp/address", udp_address, "");
+	pnh.param("udp/port", udp_port, 45045);
+
+	if (rate <= 0.0 || sensors < 1 || taxels < 1) {
+		ROS_FATAL("rate, sensors and taxels have to be positive");
+		return 1;
+	}
+
+	ros::Publisher pub = nh.advertise<tactile_msgs::TactileState>("/kd45_tactile", 100);
+
+	// Optional UDP output, unicast or multicast depending on the address
+	int udp_socket = -1;
+	sockaddr_in destination{};
+	if (!udp_address.empty()) {
+		destination.sin_family = AF_INET;
+		destination.sin_port = htons(udp_port);
+		udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+		if (inet_pton(AF_INET, udp_address.c_str(), &destination.sin_addr) != 1 || udp_socket < 0) {
+			ROS_FATAL_STREAM("Can't send tactile datagrams to " << udp_address << ": " << std::strerror(errno));
+			return 1;
+		}
+		ROS_INFO_STREAM("Sending tactile datagrams to " << udp_address << ":" << udp_port);
+	}
+	Packet packet;
+	uint8_t datagram[Packet::kSize];
+
+	// Preallocated, only the values change between messages
+	tactile_msgs::TactileState msg;
+	msg.sensors.resize(sensors);
+	for (int i = 0; i < sensors; ++i) {
+		msg.sensors[i].name = "kd45_" + std::to_string(i);
+		msg.sensors[i].values.resize(taxels);
+	}
+
+	ROS_INFO_STREAM("Publishing " << sensors << " sensors with " << taxels << " taxels at " << rate << "Hz");
+
+	const ros::Time start = ros::Time::now();
+	ros::Rate loop(rate);
+	uint32_t seq = 0;
+	while (ros::ok()) {
+		const ros::Time now = ros::Time::now();
+		const double t = (now - start).toSec();
+		for (int i = 0; i < sensors; ++i) {
+			std::vector<float>& values = msg.sensors[i].values;
+			const double force = offset + amplitude * std::sin(2.0 * M_PI * frequency * t + i * M_PI / sensors);
+			for (int j = 0; j < taxels; ++j) values[j] = force * (1.0 - static_cast<double>(j) / taxels);
+		}
+
+		msg.header.seq = seq;
+		msg.header.stamp = now;
+		pub.publish(msg);
+
+		if (udp_socket >= 0) {
+			packet.seq = seq;
+			packet.sec = now.sec;
+			packet.nsec = now.nsec;
+			for (unsigned int i = 0; i < packet.forces.size(); ++i) {
+				packet.forces[i] = i < msg.sensors.size() ? msg.sensors[i].values[0] : 0.0f;
+			}
+			packet.encode(datagram);
+			sendto(udp_socket, datagram, sizeof(datagram), 0, reinterpret_cast<sockaddr*>(&destination),
+			       sizeof(destination));
+		}
+		++seq;
+
+		ros::spinOnce();
+		if (!loop.sleep()) ROS_WARN_THROTTLE(1, "Tactile generator can't keep up with %.0fHz", rate);
+	}
+	if (udp_socket >= 0) close(udp_socket);
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#include <gtest/gtest.h>
+
+#include <active_goal.h>
+#include <epoch_domain.h>
+
+#include "canary.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+using namespace kd45_controller;
+
+namespace {
+
+// stands in for the realtime goal handle: a result is set once, either by the realtime loop or by a preemption
+struct Goal : test::Canary
+{
+	enum State
+	{
+		ACTIVE,
+		SUCCEEDED,
+		CANCELED
+	};
+
+	bool setResult(State result) {
+		int active = ACTIVE;
+		return state.compare_exchange_strong(active, result);
+	}
+
+	std::atomic<int> state{ ACTIVE };
+	std::atomic<bool> finished{ false };
+};
+typedef std::shared_ptr<Goal> GoalPtr;
+
+// creates goals that are buried instead of deleted, and counts goals freed without a result
+class Graveyard
+{
+public:
+	GoalPtr create() {
+		return GoalPtr(new Goal(), [this](Goal* goal) {
+			if (goal->state.load() == Goal::ACTIVE) hanging_++;
+			goals_.bury(goal);
+		});
+	}
+
+	size_t hanging() const { return hanging_.load(); }
+
+private:
+	test::Graveyard<Goal> goals_;
+	std::atomic<size_t> hanging_{ 0 };
+};
+}
+
+TEST(ActiveGoal, AdoptsEveryInstallation) {
+	EpochDomain domain;
+	ActiveGoal<GoalPtr> active_goal(domain);
+	GoalPtr goal = std::make_shared<Goal>();
+
+	domain.enter();
+	EXPECT_FALSE(active_goal.update());
+	EXPECT_EQ(active_goal.get(), nullptr);
+
+	active_goal.install(goal);
+	domain.enter();
+	EXPECT_TRUE(active_goal.update());
+	EXPECT_EQ(active_goal.get(), goal.get());
+	EXPECT_FALSE(active_goal.update());
+
+	// the realtime loop finished the goal, installing it again makes it active again
+	active_goal.set(nullptr);
+	active_goal.install(goal);
+	domain.enter();
+	EXPECT_TRUE(active_goal.update());
+	EXPECT_EQ(active_goal.get(), goal.get());
+	EXPECT_EQ(active_goal.installed(), goal);
+}
+
+// installations from an action thread against the realtime loop adopting and finishing them, run it with
+// ThreadSanitizer. kd45_controller_rostest does the same with the whole controller
+TEST(ActiveGoal, StressInstallAndFinish) {
+	Graveyard graveyard;
+	std::atomic<uint64_t> violations{ 0 };
+	{
+		EpochDomain domain;
+		ActiveGoal<GoalPtr> active_goal(domain);
+		domain.startReclaimer(std::chrono::milliseconds(1));
+		std::atomic<bool> running{ true };
+
+		std::thread realtime([&] {
+			uint64_t cycle = 0;
+			while (running.load()) {
+				domain.enter();
+				active_goal.update();
+				Goal* active = active_goal.get();
+				if (!active) continue;
+				if (!active->alive()) violations++;
+
+				// the realtime loop finishes some goals before the next one is installed
+				if (++cycle % 7 == 0) {
+					active->setResult(Goal::SUCCEEDED);
+					active->finished = true;
+					active_goal.set(nullptr);
+				}
+			}
+		});
+		std::thread action([&] {
+			for (int i = 0; i < 20000; ++i) {
+				const GoalPtr previous = active_goal.installed();
+				active_goal.install(i % 11 == 0 ? GoalPtr() : graveyard.create());
+				if (previous) previous->setResult(Goal::CANCELED);
+			}
+		});
+
+		action.join();
+		running = false;
+		realtime.join();
+
+		// a preemption at the end, like stopping the controller
+		const GoalPtr last = active_goal.installed();
+		if (last) last->setResult(Goal::CANCELED);
+		active_goal.install(GoalPtr());
+		domain.quiesce();
+		domain.stopReclaimer();
+	}
+	EXPECT_EQ(violations.load(), 0u);
+	EXPECT_EQ(graveyard.hanging(), 0u);
+}
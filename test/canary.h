@@ -0,0 +1,89 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_TEST_CANARY_H
+#define KD45_CONTROLLER_TEST_CANARY_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace kd45_controller {
+namespace test {
+
+const uint64_t kAlive = 0x4b44343541;
+const uint64_t kFreed = 0xdeadbeef;
+
+// base of objects handed between threads in the tests. Freed objects are poisoned instead of deleted, so a thread
+// that reaches a freed object sees it instead of relying on a sanitizer to notice the use after free
+struct Canary
+{
+	bool alive() const { return canary.load() == kAlive; }
+
+	std::atomic<uint64_t> canary{ kAlive };
+};
+
+// objects freed by the code under test, deleted at the end of the test
+template <class T>
+class Graveyard
+{
+public:
+	~Graveyard() {
+		for (T* object : objects_) delete object;
+	}
+
+	void bury(T* object) {
+		object->canary.store(kFreed);
+		std::lock_guard<std::mutex> lock(mutex_);
+		objects_.push_back(object);
+	}
+
+	size_t size() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return objects_.size();
+	}
+
+private:
+	std::mutex mutex_;
+	std::vector<T*> objects_;
+};
+}
+}
+
+#endif  // KD45_CONTROLLER_TEST_CANARY_H
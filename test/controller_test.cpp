@@ -0,0 +1,227 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#include <gtest/gtest.h>
+
+#include <control_msgs/QueryTrajectoryState.h>
+#include <trajectory_msgs/JointTrajectory.h>
+#include <trajectory_msgs/JointTrajectoryPoint.h>
+
+#include "fake_gripper.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace kd45_controller;
+using test::ClientGoalHandle;
+
+namespace {
+
+// sets up the parameters of a controller in a namespace of its own per test, so that topics and the action server of
+// an earlier test can not interfere
+class ControllerTest : public ::testing::Test
+{
+protected:
+	void SetUp() override {
+		ns_ = std::string("/") + ::testing::UnitTest::GetInstance()->current_test_info()->name();
+		ros::param::set(ns_ + "/robot_description", std::string(test::kRobotDescription));
+
+		std::vector<std::string> joints(test::kJointNames, test::kJointNames + kNumFingers);
+		params().setParam("joints", joints);
+		params().setParam("constraints/goal_time", 0.5);
+		params().setParam("constraints/stopped_velocity_tolerance", 1.0);
+		for (const std::string& joint : joints) params().setParam("constraints/" + joint + "/goal", 0.002);
+	}
+
+	// the parameters of the controller, set before start()
+	ros::NodeHandle params() const { return ros::NodeHandle(ns_ + "/gripper_controller"); }
+	std::string topic(const std::string& name) const { return ns_ + "/gripper_controller/" + name; }
+
+	bool start() {
+		loop_.reset(new test::ControlLoop(ns_));
+		if (!loop_->start()) return false;
+		client_.reset(new test::ActionClient(nh_, topic("follow_joint_trajectory")));
+		return client_->waitForActionServerToStart(ros::Duration(5.0));
+	}
+
+	template <class Message>
+	ros::Publisher advertise(const std::string& name) {
+		ros::Publisher publisher = nh_.advertise<Message>(topic(name), 10);
+		test::waitFor([&publisher] { return publisher.getNumSubscribers() > 0; }, 5.0);
+		return publisher;
+	}
+
+	ros::NodeHandle nh_;
+	std::string ns_;
+	std::unique_ptr<test::ControlLoop> loop_;
+	std::unique_ptr<test::ActionClient> client_;
+};
+}
+
+// goals, trajectory commands, streamed setpoints and state queries from their own threads against the realtime loop of
+// the controller, run it with ThreadSanitizer. Every goal has to get a result and the controller has to stay usable
+TEST_F(ControllerTest, ConcurrentCommands) {
+	params().setParam("goal_queue/enabled", true);
+	ASSERT_TRUE(start());
+	ros::Publisher command = advertise<trajectory_msgs::JointTrajectory>("command");
+	ros::Publisher stream = advertise<trajectory_msgs::JointTrajectoryPoint>("stream_command");
+
+	std::atomic<bool> running{ true };
+	std::thread streamer([&] {
+		for (int i = 0; running.load(); ++i) {
+			trajectory_msgs::JointTrajectoryPoint setpoint;
+			setpoint.positions.assign(kNumFingers, 0.01 + 0.0001 * (i % 100));
+			stream.publish(setpoint);
+			std::this_thread::sleep_for(std::chrono::milliseconds(7));
+		}
+	});
+	std::thread commander([&] {
+		for (int i = 0; running.load(); ++i) {
+			// every third trajectory is empty and holds position
+			trajectory_msgs::JointTrajectory trajectory = test::makeGoal(0.01 + 0.001 * (i % 20), 0.05).trajectory;
+			if (i % 3 == 0) trajectory.points.clear();
+			command.publish(trajectory);
+			std::this_thread::sleep_for(std::chrono::milliseconds(11));
+		}
+	});
+	std::thread query([&] {
+		while (running.load()) {
+			control_msgs::QueryTrajectoryState state;
+			state.request.time = ros::Time::now();
+			ros::service::call(topic("query_state"), state);
+			std::this_thread::sleep_for(std::chrono::milliseconds(3));
+		}
+	});
+
+	// goals replacing the current one and goals queued behind it, some of them canceled right away
+	std::vector<ClientGoalHandle> goals;
+	for (int i = 0; i < 300; ++i) {
+		control_msgs::FollowJointTrajectoryGoal goal = test::makeGoal(0.005 + 0.001 * (i % 30), 0.01 + 0.001 * (i % 7));
+		if (i % 4 == 0) goal.trajectory.header.stamp = ros::Time::now();
+		goals.push_back(client_->sendGoal(goal));
+		if (i % 9 == 0) goals[i / 2].cancel();
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+
+	running = false;
+	streamer.join();
+	commander.join();
+	query.join();
+
+	for (size_t i = 0; i < goals.size(); ++i) {
+		EXPECT_NE(test::result(goals[i]), actionlib::TerminalState::LOST) << "goal " << i;
+	}
+	ClientGoalHandle last = client_->sendGoal(test::makeGoal(0.03, 0.1));
+	EXPECT_EQ(test::result(last), actionlib::TerminalState::SUCCEEDED);
+
+	loop_->stop();
+	EXPECT_NEAR(loop_->gripper().position(0), 0.03, 0.002);
+	EXPECT_NEAR(loop_->gripper().position(1), 0.03, 0.002);
+}
+
+// the force limit freezes the fingers, while the pads are still pressed a goal closing the gripper further is aborted
+// and the fingers stay where they are
+TEST_F(ControllerTest, ClosingWhileAboveForceLimit) {
+	params().setParam("force_limit/max_force", 5.0);
+	ASSERT_TRUE(start());
+
+	// contact 0.1s into a slow closing motion
+	ClientGoalHandle closing = client_->sendGoal(test::makeGoal(0.0, 2.0));
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	loop_->sensor().press(10.0f, 10.0f);
+	EXPECT_EQ(test::result(closing), actionlib::TerminalState::ABORTED);
+
+	ClientGoalHandle closing_again = client_->sendGoal(test::makeGoal(0.0, 0.2));
+	EXPECT_EQ(test::result(closing_again), actionlib::TerminalState::ABORTED);
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+	loop_->stop();
+	for (unsigned int i = 0; i < kNumFingers; ++i) EXPECT_GT(loop_->gripper().position(i), 0.015);
+}
+
+// a goal opening the gripper is followed while the pads are still pressed
+TEST_F(ControllerTest, OpeningWhileAboveForceLimit) {
+	params().setParam("force_limit/max_force", 5.0);
+	ASSERT_TRUE(start());
+
+	ClientGoalHandle closing = client_->sendGoal(test::makeGoal(0.0, 2.0));
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	loop_->sensor().press(10.0f, 10.0f);
+	EXPECT_EQ(test::result(closing), actionlib::TerminalState::ABORTED);
+
+	ClientGoalHandle opening = client_->sendGoal(test::makeGoal(0.04, 0.2));
+	EXPECT_EQ(test::result(opening), actionlib::TerminalState::SUCCEEDED);
+
+	loop_->stop();
+	for (unsigned int i = 0; i < kNumFingers; ++i) EXPECT_NEAR(loop_->gripper().position(i), 0.04, 0.002);
+}
+
+// a goal opening the gripper queued behind a goal closing it with grasp verification: the fingers hold the grasp until
+// it is verified, then open. Both goals succeed
+TEST_F(ControllerTest, CloseThenOpenQueued) {
+	params().setParam("goal_queue/enabled", true);
+	params().setParam("grasp_verification/enabled", true);
+	ASSERT_TRUE(start());
+	loop_->sensor().press(1.0f, 1.0f);
+
+	// queued once the closing goal is accepted, not coalesced with it
+	ClientGoalHandle closing = client_->sendGoal(test::makeGoal(0.01, 0.2));
+	ASSERT_TRUE(test::waitFor([&closing] { return closing.getCommState() == actionlib::CommState::ACTIVE; }, 1.0));
+	ClientGoalHandle opening = client_->sendGoal(test::makeGoal(0.04, 0.2));
+	EXPECT_EQ(test::result(closing), actionlib::TerminalState::SUCCEEDED);
+	EXPECT_EQ(test::result(opening), actionlib::TerminalState::SUCCEEDED);
+
+	loop_->stop();
+	for (unsigned int i = 0; i < kNumFingers; ++i) EXPECT_NEAR(loop_->gripper().position(i), 0.04, 0.002);
+}
+
+int main(int argc, char** argv) {
+	testing::InitGoogleTest(&argc, argv);
+	ros::init(argc, argv, "kd45_controller_rostest");
+
+	// Callbacks of the controller and the action client run concurrently, like with a multi-threaded spinner
+	ros::AsyncSpinner spinner(4);
+	spinner.start();
+	const int result = RUN_ALL_TESTS();
+	spinner.stop();
+	ros::shutdown();
+	return result;
+}
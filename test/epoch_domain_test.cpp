@@ -0,0 +1,168 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#include <gtest/gtest.h>
+
+#include <epoch_domain.h>
+
+#include "canary.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace kd45_controller;
+
+namespace {
+
+// an object reached by the reader
+struct Node : test::Canary
+{
+	explicit Node(uint64_t value) : value(value) {}
+
+	uint64_t value;
+};
+typedef test::Graveyard<Node> Graveyard;
+}
+
+TEST(EpochDomain, ReclaimsOnlyWhatTheReaderCanNotReach) {
+	EpochDomain domain;
+	Graveyard graveyard;
+	std::atomic<Node*> current{ new Node(0) };
+
+	domain.enter();
+	Node* reached = current.load();
+	Node* replacement = new Node(1);
+	current.store(replacement);
+	domain.retire([&graveyard, reached] { graveyard.bury(reached); });
+
+	// the reader has not entered a later epoch yet
+	domain.reclaim();
+	EXPECT_EQ(domain.retiredCount(), 1u);
+	EXPECT_TRUE(reached->alive());
+
+	domain.enter();
+	domain.reclaim();
+	EXPECT_EQ(domain.retiredCount(), 0u);
+	EXPECT_EQ(graveyard.size(), 1u);
+	delete replacement;
+}
+
+TEST(EpochDomain, QuiescentReaderHoldsNothing) {
+	EpochDomain domain;
+	int freed = 0;
+	domain.enter();
+	domain.retire([&freed] { freed++; });
+	domain.quiesce();
+	domain.reclaim();
+	EXPECT_EQ(freed, 1);
+}
+
+TEST(EpochDomain, FreesTheRestOnDestruction) {
+	int freed = 0;
+	{
+		EpochDomain domain;
+		domain.enter();
+		domain.retire([&freed] { freed++; });
+		domain.retire([&freed] { freed++; });
+	}
+	EXPECT_EQ(freed, 2);
+}
+
+// the reclaimer thread against a reader that follows the current node every cycle and writers replacing it
+TEST(EpochDomain, StressReclaimerAgainstReader) {
+	EpochDomain domain;
+	Graveyard graveyard;
+	std::atomic<Node*> current{ new Node(0) };
+	std::atomic<bool> running{ true };
+	std::atomic<uint64_t> violations{ 0 };
+	std::atomic<uint64_t> cycles{ 0 };
+
+	domain.startReclaimer(std::chrono::milliseconds(1));
+
+	std::thread reader([&] {
+		uint64_t last = 0;
+		while (running.load()) {
+			domain.enter();
+			Node* node = current.load();
+			// the node stays valid for the whole cycle, even if it is replaced meanwhile
+			for (int i = 0; i < 8; ++i) {
+				if (!node->alive()) violations++;
+			}
+			if (node->value < last) violations++;
+			last = node->value;
+			cycles++;
+			if (cycles % 1024 == 0) domain.quiesce();
+		}
+		domain.quiesce();
+	});
+
+	const unsigned int kWriters = 3;
+	const uint64_t kReplacements = 20000;
+	std::atomic<uint64_t> next_value{ 1 };
+	std::mutex publish_mutex;
+	std::vector<std::thread> writers;
+	for (unsigned int w = 0; w < kWriters; ++w) {
+		writers.emplace_back([&] {
+			for (uint64_t i = 0; i < kReplacements; ++i) {
+				Node* old;
+				{
+					// values are published in order, like trajectories under the trajectory mutex
+					std::lock_guard<std::mutex> lock(publish_mutex);
+					old = current.exchange(new Node(next_value++));
+				}
+				domain.retire([&graveyard, old] { graveyard.bury(old); });
+			}
+		});
+	}
+	for (std::thread& writer : writers) writer.join();
+	running = false;
+	reader.join();
+	domain.stopReclaimer();
+	domain.reclaim();
+
+	EXPECT_EQ(violations.load(), 0u);
+	EXPECT_GT(cycles.load(), 0u);
+	EXPECT_EQ(domain.retiredCount(), 0u);
+	EXPECT_EQ(graveyard.size(), kWriters * kReplacements);
+	delete current.load();
+}
@@ -0,0 +1,225 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+#ifndef KD45_CONTROLLER_TEST_FAKE_GRIPPER_H
+#define KD45_CONTROLLER_TEST_FAKE_GRIPPER_H
+
+#include <kd45_controller.h>
+
+#include <actionlib/client/action_client.h>
+#include <control_msgs/FollowJointTrajectoryAction.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <ros/ros.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace kd45_controller {
+namespace test {
+
+const char* const kJointNames[kNumFingers] = { "right_finger_joint", "left_finger_joint" };
+
+// two prismatic fingers, all the base class needs from the robot description
+const char kRobotDescription[] =
+    "<robot name=\"kd45\">"
+    "  <link name=\"base\"/><link name=\"right_finger\"/><link name=\"left_finger\"/>"
+    "  <joint name=\"right_finger_joint\" type=\"prismatic\">"
+    "    <parent link=\"base\"/><child link=\"right_finger\"/><axis xyz=\"1 0 0\"/>"
+    "    <limit lower=\"0.0\" upper=\"0.05\" effort=\"10.0\" velocity=\"1.0\"/>"
+    "  </joint>"
+    "  <joint name=\"left_finger_joint\" type=\"prismatic\">"
+    "    <parent link=\"base\"/><child link=\"left_finger\"/><axis xyz=\"-1 0 0\"/>"
+    "    <limit lower=\"0.0\" upper=\"0.05\" effort=\"10.0\" velocity=\"1.0\"/>"
+    "  </joint>"
+    "</robot>";
+
+// where the fingers start, half open
+const double kStartPosition = 0.02;
+
+// tactile sensor policy of the controller tests. The test presses the pads instead of a sensor thread receiving samples
+class FakeTactileSensor
+{
+public:
+	FakeTactileSensor(ros::NodeHandle& /*root_nh*/, std::shared_ptr<ForceChannel<kNumFingers>> forces,
+	                  std::shared_ptr<ForceLimit<kNumFingers>> force_limit)
+	    : forces_(forces), force_limit_(force_limit) {}
+
+	// like a sensor receiving a sample, from a single thread
+	void press(float right, float left) {
+		const Forces forces = { { right, left } };
+		force_limit_->check(forces, ros::Time::now());
+		forces_->store(forces);
+	}
+
+	const MessageStats& stats() const { return stats_; }
+
+private:
+	std::shared_ptr<ForceChannel<kNumFingers>> forces_;
+	std::shared_ptr<ForceLimit<kNumFingers>> force_limit_;
+	MessageStats stats_;
+};
+
+// position controlled fingers that reach the command within one cycle
+class FakeGripper : public hardware_interface::RobotHW
+{
+public:
+	FakeGripper() {
+		for (unsigned int i = 0; i < kNumFingers; ++i) {
+			position_[i] = command_[i] = kStartPosition;
+			hardware_interface::JointStateHandle state(kJointNames[i], &position_[i], &velocity_[i], &effort_[i]);
+			position_interface_.registerHandle(hardware_interface::JointHandle(state, &command_[i]));
+		}
+		registerInterface(&position_interface_);
+	}
+
+	// realtime, before every update
+	void read(const ros::Duration& period) {
+		for (unsigned int i = 0; i < kNumFingers; ++i) {
+			velocity_[i] = period.isZero() ? 0.0 : (command_[i] - position_[i]) / period.toSec();
+			position_[i] = command_[i];
+		}
+	}
+
+	// only while the control loop is stopped
+	double position(unsigned int joint) const { return position_[joint]; }
+
+private:
+	hardware_interface::PositionJointInterface position_interface_;
+	double position_[kNumFingers];
+	double velocity_[kNumFingers] = {};
+	double effort_[kNumFingers] = {};
+	double command_[kNumFingers];
+};
+
+class TestController : public KD45TrajectoryController<FakeTactileSensor>
+{
+public:
+	FakeTactileSensor& sensor() { return *sensors_; }
+};
+
+// the controller on the fake gripper, updated at 1kHz in its own thread like by the controller manager. Parameters
+// are read from <ns>/gripper_controller and the robot description from <ns>/robot_description
+class ControlLoop
+{
+public:
+	explicit ControlLoop(const std::string& ns) : root_nh_(ns), controller_nh_(ns + "/gripper_controller") {}
+	~ControlLoop() { stop(); }
+
+	bool start() {
+		// Like the controller manager, through the base class where initRequest() is public
+		controller_interface::ControllerBase& controller = controller_;
+		controller_interface::ControllerBase::ClaimedResources claimed;
+		if (!controller.initRequest(&gripper_, root_nh_, controller_nh_, claimed)) return false;
+		running_ = true;
+		thread_ = std::thread(&ControlLoop::run, this);
+		return true;
+	}
+
+	void stop() {
+		running_ = false;
+		if (thread_.joinable()) thread_.join();
+	}
+
+	TestController& controller() { return controller_; }
+	FakeTactileSensor& sensor() { return controller_.sensor(); }
+	// only while the control loop is stopped
+	const FakeGripper& gripper() const { return gripper_; }
+
+private:
+	void run() {
+		ros::Time last = ros::Time::now();
+		controller_.startRequest(last);
+		while (running_) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			const ros::Time now = ros::Time::now();
+			const ros::Duration period = now - last;
+			last = now;
+			gripper_.read(period);
+			controller_.updateRequest(now, period);
+		}
+		controller_.stopRequest(last);
+	}
+
+	ros::NodeHandle root_nh_;
+	ros::NodeHandle controller_nh_;
+	FakeGripper gripper_;
+	TestController controller_;
+	std::atomic<bool> running_{ false };
+	std::thread thread_;
+};
+
+typedef actionlib::ActionClient<control_msgs::FollowJointTrajectoryAction> ActionClient;
+typedef ActionClient::GoalHandle ClientGoalHandle;
+
+// both fingers to position within duration
+inline control_msgs::FollowJointTrajectoryGoal makeGoal(double position, double duration) {
+	control_msgs::FollowJointTrajectoryGoal goal;
+	goal.trajectory.joint_names.assign(kJointNames, kJointNames + kNumFingers);
+	goal.trajectory.points.resize(1);
+	goal.trajectory.points[0].positions.assign(kNumFingers, position);
+	goal.trajectory.points[0].velocities.assign(kNumFingers, 0.0);
+	goal.trajectory.points[0].time_from_start = ros::Duration(duration);
+	return goal;
+}
+
+inline bool waitFor(const std::function<bool()>& done, double timeout) {
+	const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(timeout);
+	while (!done()) {
+		if (ros::WallTime::now() > deadline) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	return true;
+}
+
+inline bool done(ClientGoalHandle& goal) { return goal.getCommState() == actionlib::CommState::DONE; }
+
+// waits for the result of goal, LOST if there is none within timeout
+inline actionlib::TerminalState::StateEnum result(ClientGoalHandle& goal, double timeout = 5.0) {
+	if (!waitFor([&goal] { return done(goal); }, timeout)) return actionlib::TerminalState::LOST;
+	return goal.getTerminalState().state_;
+}
+}
+}
+
+#endif  // KD45_CONTROLLER_TEST_FAKE_GRIPPER_H
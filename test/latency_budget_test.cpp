@@ -0,0 +1,122 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#include <gtest/gtest.h>
+
+#include <latency_budget.h>
+
+#include <array>
+#include <chrono>
+#include <thread>
+
+using namespace kd45_controller;
+
+namespace {
+
+// budgets far below the forced delay, and far above what an empty stage takes
+const double kTightBudget = 0.0005;
+const double kLooseBudget = 1.0;
+const std::chrono::milliseconds kOverrun(5);
+
+void runStage(LatencyBudget& budget, LatencyBudget::Stage stage, bool overrun) {
+	budget.startStage(stage);
+	if (overrun) std::this_thread::sleep_for(kOverrun);
+	budget.endStage(stage);
+}
+}
+
+TEST(LatencyBudget, DisabledCountsNothing) {
+	LatencyBudget budget;
+	budget.configure(0.0, { { 0.0, 0.0, 0.0, 0.0 } }, true);
+	EXPECT_FALSE(budget.enabled());
+
+	budget.startCycle();
+	runStage(budget, LatencyBudget::SAMPLING, true);
+	EXPECT_FALSE(budget.skipNonCritical());
+	EXPECT_EQ(0u, budget.stageOverruns(LatencyBudget::SAMPLING));
+	EXPECT_EQ(0u, budget.cycleOverruns());
+	EXPECT_EQ(0u, budget.skippedCycles());
+}
+
+TEST(LatencyBudget, StageOverrunSkipsTheRestOfTheCycle) {
+	LatencyBudget budget;
+	budget.configure(kLooseBudget, { { kTightBudget, 0.0, 0.0, 0.0 } }, true);
+	ASSERT_TRUE(budget.enabled());
+
+	budget.startCycle();
+	runStage(budget, LatencyBudget::SAMPLING, true);
+	runStage(budget, LatencyBudget::COMMAND, false);
+	EXPECT_EQ(1u, budget.stageOverruns(LatencyBudget::SAMPLING));
+	EXPECT_EQ(0u, budget.stageOverruns(LatencyBudget::COMMAND));
+	EXPECT_EQ(0u, budget.cycleOverruns());
+
+	// both non-critical stages are skipped, the cycle is counted once
+	EXPECT_TRUE(budget.skipNonCritical());
+	EXPECT_TRUE(budget.skipNonCritical());
+	EXPECT_EQ(1u, budget.skippedCycles());
+
+	// the next cycle is on time again
+	budget.startCycle();
+	runStage(budget, LatencyBudget::SAMPLING, false);
+	EXPECT_FALSE(budget.skipNonCritical());
+	EXPECT_EQ(1u, budget.stageOverruns(LatencyBudget::SAMPLING));
+	EXPECT_EQ(1u, budget.skippedCycles());
+}
+
+TEST(LatencyBudget, CycleOverrunIsCountedOncePerCycle) {
+	LatencyBudget budget;
+	budget.configure(kTightBudget, { { 0.0, 0.0, 0.0, 0.0 } }, false);
+
+	for (int cycle = 0; cycle < 2; ++cycle) {
+		budget.startCycle();
+		runStage(budget, LatencyBudget::SAMPLING, true);
+		runStage(budget, LatencyBudget::COMMAND, false);
+		runStage(budget, LatencyBudget::FEEDBACK, false);
+		// counted, but nothing is skipped unless configured
+		EXPECT_FALSE(budget.skipNonCritical());
+	}
+	EXPECT_EQ(2u, budget.cycleOverruns());
+	EXPECT_EQ(0u, budget.skippedCycles());
+	for (int i = 0; i < LatencyBudget::NUM_STAGES; ++i)
+		EXPECT_EQ(0u, budget.stageOverruns(static_cast<LatencyBudget::Stage>(i)));
+
+	// a new configuration starts from zero
+	budget.configure(kTightBudget, { { 0.0, 0.0, 0.0, 0.0 } }, false);
+	EXPECT_EQ(0u, budget.cycleOverruns());
+}
@@ -0,0 +1,122 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#include <gtest/gtest.h>
+
+#include <epoch_domain.h>
+#include <mailbox.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace kd45_controller;
+
+namespace {
+
+// counts live instances, to check that every replaced value is freed exactly once
+struct Counted
+{
+	static std::atomic<int> live;
+
+	Counted(uint64_t value = 0) : value(value) { live++; }
+	Counted(const Counted& other) : value(other.value) { live++; }
+	~Counted() { live--; }
+
+	uint64_t value;
+};
+std::atomic<int> Counted::live{ 0 };
+}
+
+TEST(Mailbox, PublishesAndVersions) {
+	EpochDomain domain;
+	Mailbox<int> mailbox(domain, 1);
+	domain.enter();
+	EXPECT_EQ(mailbox.read(), 1);
+	EXPECT_EQ(mailbox.version(), 0u);
+
+	mailbox.publish(2);
+	domain.enter();
+	EXPECT_EQ(mailbox.read(), 2);
+	EXPECT_EQ(mailbox.version(), 1u);
+}
+
+TEST(Mailbox, StressWritersAgainstReader) {
+	{
+		EpochDomain domain;
+		Mailbox<Counted> mailbox(domain, Counted(0));
+		domain.startReclaimer(std::chrono::milliseconds(1));
+		std::atomic<bool> running{ true };
+		std::atomic<uint64_t> violations{ 0 };
+
+		std::thread reader([&] {
+			uint64_t last_version = 0;
+			while (running.load()) {
+				domain.enter();
+				const uint64_t version = mailbox.version();
+				const Counted& value = mailbox.read();
+				// the value read is at least as new as the version read before it
+				if (version < last_version || value.value < version) violations++;
+				last_version = version;
+			}
+			domain.quiesce();
+		});
+
+		std::vector<std::thread> writers;
+		std::atomic<uint64_t> published{ 0 };
+		std::mutex publish_mutex;
+		for (int w = 0; w < 3; ++w) {
+			writers.emplace_back([&] {
+				for (int i = 0; i < 20000; ++i) {
+					std::lock_guard<std::mutex> lock(publish_mutex);
+					mailbox.publish(Counted(++published));
+				}
+			});
+		}
+		for (std::thread& writer : writers) writer.join();
+		running = false;
+		reader.join();
+
+		EXPECT_EQ(violations.load(), 0u);
+		EXPECT_EQ(mailbox.version(), published.load());
+	}
+	EXPECT_EQ(Counted::live.load(), 0);
+}
@@ -0,0 +1,173 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2020, Bielefeld University
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Bielefeld University nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+/* Author: Luca Lach
+*/
+
+
+
+#include <gtest/gtest.h>
+
+#include <message_stats.h>
+
+#include <cstdint>
+
+using namespace kd45_controller;
+
+namespace {
+
+// messages without a stamp, only the sequence numbers are tracked
+void receive(MessageStats& stats, uint32_t seq) {
+	stats.update(seq, ros::Time(), ros::Time(1, 0));
+}
+}
+
+TEST(MessageStats, InOrder) {
+	MessageStats stats;
+	for (uint32_t seq = 10; seq < 20; ++seq) receive(stats, seq);
+
+	EXPECT_EQ(10u, stats.received());
+	EXPECT_EQ(0u, stats.lost());
+	EXPECT_EQ(0u, stats.gaps());
+	EXPECT_EQ(0u, stats.reordered());
+	EXPECT_EQ(0u, stats.restarts());
+}
+
+TEST(MessageStats, Gaps) {
+	MessageStats stats;
+	receive(stats, 1);
+	receive(stats, 4);
+	receive(stats, 5);
+	receive(stats, 7);
+
+	EXPECT_EQ(4u, stats.received());
+	EXPECT_EQ(3u, stats.lost());
+	EXPECT_EQ(2u, stats.gaps());
+	EXPECT_EQ(0u, stats.reordered());
+}
+
+TEST(MessageStats, LateMessagesAreNotLost) {
+	MessageStats stats;
+	receive(stats, 1);
+	receive(stats, 4);
+	receive(stats, 3);
+	receive(stats, 2);
+	receive(stats, 5);
+
+	EXPECT_EQ(5u, stats.received());
+	EXPECT_EQ(0u, stats.lost());
+	EXPECT_EQ(1u, stats.gaps());
+	EXPECT_EQ(2u, stats.reordered());
+	EXPECT_EQ(0u, stats.duplicates());
+	EXPECT_EQ(0u, stats.restarts());
+}
+
+TEST(MessageStats, DuplicatesDoNotHideLoss) {
+	MessageStats stats;
+	receive(stats, 1);
+	receive(stats, 4);
+	// 2 and 3 are missing, repeating the received numbers must not make up for them
+	receive(stats, 4);
+	receive(stats, 1);
+	receive(stats, 4);
+	EXPECT_EQ(2u, stats.lost());
+	EXPECT_EQ(0u, stats.reordered());
+	EXPECT_EQ(3u, stats.duplicates());
+
+	// a late message is only taken off the loss once
+	receive(stats, 3);
+	receive(stats, 3);
+	EXPECT_EQ(1u, stats.lost());
+	EXPECT_EQ(1u, stats.reordered());
+	EXPECT_EQ(4u, stats.duplicates());
+}
+
+TEST(MessageStats, LateMessagesAfterALargeGap) {
+	MessageStats stats;
+	receive(stats, 0);
+	receive(stats, 3000);
+	EXPECT_EQ(2999u, stats.lost());
+
+	// everything not taken as a restart is remembered as missing
+	receive(stats, 3001 - MessageStats::kRestartThreshold);
+	receive(stats, 2999);
+	EXPECT_EQ(2997u, stats.lost());
+	EXPECT_EQ(2u, stats.reordered());
+	EXPECT_EQ(0u, stats.duplicates());
+	EXPECT_EQ(0u, stats.restarts());
+}
+
+TEST(MessageStats, RestartedPublisher) {
+	MessageStats stats;
+	for (uint32_t seq = 5000; seq < 5010; ++seq) receive(stats, seq);
+
+	// far behind the expected number: a new publisher, not a late message
+	receive(stats, 0);
+	receive(stats, 1);
+	EXPECT_EQ(1u, stats.restarts());
+	EXPECT_EQ(0u, stats.reordered());
+	EXPECT_EQ(0u, stats.lost());
+	EXPECT_EQ(0u, stats.gaps());
+
+	// numbers missing before the restart are forgotten, within the threshold a late message still counts
+	receive(stats, 600);
+	receive(stats, 100);
+	EXPECT_EQ(1u, stats.restarts());
+	EXPECT_EQ(1u, stats.reordered());
+	EXPECT_EQ(597u, stats.lost());
+}
+
+TEST(MessageStats, SequenceWrapAround) {
+	MessageStats stats;
+	receive(stats, UINT32_MAX - 1);
+	receive(stats, UINT32_MAX);
+	receive(stats, 0);
+	receive(stats, 2);
+
+	EXPECT_EQ(0u, stats.restarts());
+	EXPECT_EQ(1u, stats.lost());
+	EXPECT_EQ(1u, stats.gaps());
+}
+
+TEST(MessageStats, Latency) {
+	MessageStats stats;
+	stats.update(0, ros::Time(10, 0), ros::Time(10, 2000000));
+	stats.update(1, ros::Time(11, 0), ros::Time(11, 4000000));
+	// no stamp, not part of the latency
+	stats.update(2, ros::Time(), ros::Time(12, 0));
+
+	EXPECT_NEAR(0.004, stats.lastLatency(), 1e-9);
+	EXPECT_NEAR(0.004, stats.maxLatency(), 1e-9);
+	EXPECT_NEAR(0.003, stats.meanLatency(), 1e-9);
+}